@@ -1,7 +1,15 @@
 set(SRCS 
+    AnalysisCache.cpp
+    AnalysisCache.h
+    AppFingerprint.cpp
+    AppFingerprint.h
+    Arena.cpp
+    Arena.h
     CodeAnalyzer.cpp
     CodeAnalyzer.h
     CodeAnalyzer_arm64.cpp
+    CodeFilter.cpp
+    CodeFilter.h
     DartApp.cpp
     DartApp.h
     DartClass.cpp
@@ -29,13 +37,27 @@ set(SRCS
     Disassembler_arm64.h
     ElfHelper.cpp
     ElfHelper.h
+    FnAddressIndex.cpp
+    FnAddressIndex.h
     FridaWriter.cpp
     FridaWriter.h
     HtArrayIterator.h
+    ModelExporter.cpp
+    ModelExporter.h
+    OutputFile.cpp
+    OutputFile.h
+    PhaseStats.cpp
+    PhaseStats.h
+    QueryServer.cpp
+    QueryServer.h
+    SymbolIndex.cpp
+    SymbolIndex.h
     Util.cpp
     Util.h
     VarValue.cpp
     VarValue.h
+    WorkerPool.cpp
+    WorkerPool.h
     args.hxx
     il.cpp
     il.h
@@ -43,3 +65,8 @@ set(SRCS
     #pch.cpp
     pch.h
 )
+
+# sources of benchmark harness (blutter_bench target) in addition to SRCS without main.cpp
+set(BENCH_SRCS
+    bench.cpp
+)
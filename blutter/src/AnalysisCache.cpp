@@ -0,0 +1,513 @@
+#include "pch.h"
+#include "AnalysisCache.h"
+#include "DartApp.h"
+#include <fstream>
+
+#ifndef NO_CODE_ANALYSIS
+
+static constexpr char kCacheMagic[8] = { 'B', 'L', 'U', 'T', 'C', 'A', 'C', 'H' };
+// version of cache file format
+static constexpr uint32_t kCacheVersion = 4;
+// version of analysis result. bump it when a change in CodeAnalyzer, IL or VarValue changes IL of any function,
+// so cache files created by older blutter are not used.
+static constexpr uint32_t kAnalyzerVersion = 1;
+
+static constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+static constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+static uint64_t fnvHash(uint64_t hash, const void* data, size_t size)
+{
+	auto ptr = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= ptr[i];
+		hash *= kFnvPrime;
+	}
+	return hash;
+}
+
+class CacheWriter
+{
+public:
+	explicit CacheWriter(std::ostream& os) : os(os) {}
+
+	template <typename T>
+	void Write(T val) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		os.write((const char*)&val, sizeof(T));
+	}
+	void WriteString(const std::string& s) {
+		Write((uint32_t)s.size());
+		os.write(s.data(), s.size());
+	}
+
+private:
+	std::ostream& os;
+};
+
+class CacheReader
+{
+public:
+	explicit CacheReader(std::istream& is) : is(is) {}
+
+	template <typename T>
+	T Read() {
+		static_assert(std::is_trivially_copyable_v<T>);
+		T val;
+		if (!is.read((char*)&val, sizeof(T)))
+			throw std::runtime_error("truncated cache file");
+		return val;
+	}
+	std::string ReadString() {
+		std::string s(Read<uint32_t>(), '\0');
+		if (!is.read(s.data(), s.size()))
+			throw std::runtime_error("truncated cache file");
+		return s;
+	}
+
+private:
+	std::istream& is;
+};
+
+AnalysisCache::AnalysisCache(DartApp& app, std::filesystem::path cacheDir)
+	: app(app), path(cacheDir / (app.SnapshotHash() + ".cache"))
+{
+	try {
+		load();
+	}
+	catch (std::exception& e) {
+		std::cerr << std::format("Ignore analysis cache {}: {}\n", path.string(), e.what());
+		records.clear();
+	}
+}
+
+uint64_t AnalysisCache::HashCode(const uint8_t* code, size_t size)
+{
+	return fnvHash(fnvHash(kFnvOffsetBasis, &size, sizeof(size)), code, size);
+}
+
+bool AnalysisCache::Restore(DartFunction& dartFn, uint64_t codeHash)
+{
+	const auto fnAddr = dartFn.Address();
+	auto [first, last] = records.equal_range(codeHash);
+	for (auto itr = first; itr != last; ++itr) {
+		const auto& rec = itr->second;
+		if (rec.depHash != dependencyHash(rec.deps, fnAddr))
+			continue;
+		DartType* returnType;
+		std::vector<DartType*> paramTypes(rec.params.size());
+		if (!resolveTypeRef(rec.returnType, returnType))
+			continue;
+		bool typesFound = true;
+		for (size_t i = 0; i < rec.params.size() && typesFound; i++)
+			typesFound = resolveTypeRef(rec.params[i].type, paramTypes[i]);
+		if (!typesFound)
+			continue;
+
+		auto asmTexts = rec.asmTexts;
+		for (auto& asmText : asmTexts) {
+			if (asmText.dataType == AsmText::Call)
+				asmText.callAddress += fnAddr;
+		}
+		const uint64_t firstStackLimitAddr = rec.firstStackLimitOffset ? fnAddr + rec.firstStackLimitOffset - 1 : 0;
+		auto fnInfo = std::make_unique<AnalyzedFnData>(app, dartFn, AsmTexts{ std::move(asmTexts), fnAddr, firstStackLimitAddr, rec.maxParamStackOffset });
+		fnInfo->stackSize = rec.stackSize;
+		fnInfo->returnType = returnType;
+		fnInfo->params.numFixedParam = rec.numFixedParam;
+		fnInfo->params.isNamedParam = rec.isNamedParam;
+		for (size_t i = 0; i < rec.params.size(); i++) {
+			const auto& paramRec = rec.params[i];
+			FnParamInfo param{ paramRec.name };
+			param.type = paramTypes[i];
+			param.paramOffset = paramRec.paramOffset;
+			param.localOffset = paramRec.localOffset;
+			param.paramReg = A64::Register{ (A64::Register::Value)paramRec.paramReg };
+			param.valReg = A64::Register{ (A64::Register::Value)paramRec.valReg };
+			param.valText = paramRec.valText;
+			fnInfo->params.params.push_back(std::move(param));
+		}
+		fnInfo->ils.Reserve(rec.ils.size());
+		std::string text;
+		for (const auto& il : rec.ils) {
+			text = il.text;
+			if (il.hasAddr) {
+				std::format_to(std::back_inserter(text), "{:#x}", fnAddr + il.addrOffset);
+				text += il.textSuffix;
+			}
+			fnInfo->ils.Add((ILInstr::ILKind)il.kind, AddrRange{ fnAddr + il.start, fnAddr + il.end }, text);
+		}
+		dartFn.SetAnalyzedData(std::move(fnInfo));
+		dartFn.SetStructOperands(rec.structOperands);
+
+		{
+			std::lock_guard lock(newRecordsMutex);
+			newRecords.push_back(rec);
+		}
+		numHits++;
+		return true;
+	}
+
+	numMisses++;
+	return false;
+}
+
+void AnalysisCache::Add(DartFunction& dartFn, uint64_t codeHash)
+{
+	auto fnInfo = dartFn.GetAnalyzedData();
+	const auto fnAddr = dartFn.Address();
+
+	Record rec{ .codeHash = codeHash };
+	// a function with a type that cannot be found again is analyzed in every run
+	if (!makeTypeRef(fnInfo->returnType, *fnInfo, rec.returnType))
+		return;
+	for (auto& param : fnInfo->params.params) {
+		ParamRecord paramRec{ .name = param.name, .paramOffset = param.paramOffset, .localOffset = param.localOffset,
+			.paramReg = param.paramReg.value(), .valReg = param.valReg.value(), .valText = param.ValueText() };
+		if (!makeTypeRef(param.type, *fnInfo, paramRec.type))
+			return;
+		rec.params.push_back(std::move(paramRec));
+	}
+	rec.numFixedParam = fnInfo->params.numFixedParam;
+	rec.isNamedParam = fnInfo->params.isNamedParam;
+	rec.stackSize = fnInfo->stackSize;
+
+	rec.asmTexts = fnInfo->asmTexts.Data();
+	for (auto& asmText : rec.asmTexts) {
+		if (asmText.dataType == AsmText::PoolOffset) {
+			rec.deps.push_back(Dependency{ Dependency::PoolObject, asmText.poolOffset });
+		}
+		else if (asmText.dataType == AsmText::Call) {
+			asmText.callAddress -= fnAddr;
+			rec.deps.push_back(Dependency{ Dependency::CallTarget, asmText.callAddress });
+		}
+	}
+	const auto firstStackLimitAddr = fnInfo->asmTexts.FirstStackLimitAddress();
+	rec.firstStackLimitOffset = firstStackLimitAddr ? (uint32_t)(firstStackLimitAddr - fnAddr + 1) : 0;
+	rec.maxParamStackOffset = fnInfo->asmTexts.MaxParamStackOffset();
+
+	for (auto& il : fnInfo->il_insns) {
+		ILRecord ilRec{ .kind = (uint8_t)il->Kind(), .start = (uint32_t)(il->Start() - fnAddr), .end = (uint32_t)(il->End() - fnAddr),
+			.hasAddr = false, .addrOffset = 0, .text = il->ToString() };
+
+		uint64_t absAddr = 0;
+		if (il->Kind() == ILInstr::BranchIfSmi) {
+			absAddr = reinterpret_cast<BranchIfSmiInstr*>(il.get())->branchAddr;
+		}
+		else if (il->Kind() == ILInstr::Call) {
+			auto callIL = reinterpret_cast<CallInstr*>(il.get());
+			if (callIL->GetFunction() == nullptr)
+				absAddr = callIL->GetCallAddress();
+		}
+		else if (il->Kind() == ILInstr::AllocateObject) {
+			rec.deps.push_back(Dependency{ Dependency::Class, reinterpret_cast<AllocateObjectInstr*>(il.get())->dartCls.Id() });
+		}
+
+		if (absAddr != 0) {
+			const auto addrText = std::format("{:#x}", absAddr);
+			const auto pos = ilRec.text.rfind(addrText);
+			if (pos != std::string::npos) {
+				ilRec.hasAddr = true;
+				ilRec.addrOffset = (int64_t)(absAddr - fnAddr);
+				ilRec.textSuffix = ilRec.text.substr(pos + addrText.size());
+				ilRec.text.resize(pos);
+			}
+		}
+		rec.ils.push_back(std::move(ilRec));
+	}
+
+	if (dartFn.StructOperands())
+		rec.structOperands = *dartFn.StructOperands();
+	rec.depHash = dependencyHash(rec.deps, fnAddr);
+
+	std::lock_guard lock(newRecordsMutex);
+	newRecords.push_back(std::move(rec));
+}
+
+bool AnalysisCache::makeTypeRef(DartType* type, const AnalyzedFnData& fnInfo, TypeRef& ref)
+{
+	ref = TypeRef{ TypeRef::None, 0 };
+	if (type == nullptr)
+		return true;
+
+	const auto cid = type->Class().Id();
+	if (app.classes[cid]->DeclarationType() == type) {
+		ref = TypeRef{ TypeRef::Class, cid };
+		return true;
+	}
+	if ((intptr_t)cid != app.DartFutureCid())
+		return false;
+	if (&type->Arguments() == &DartTypeArguments::Null) {
+		ref = TypeRef{ TypeRef::FutureNull, 0 };
+		return true;
+	}
+	// type arguments of async function return type are loaded from Object Pool
+	auto& pool = app.GetObjectPool();
+	for (const auto& asmText : fnInfo.asmTexts.Data()) {
+		if (asmText.dataType != AsmText::PoolOffset)
+			continue;
+		const auto idx = dart::ObjectPool::IndexFromOffset(asmText.poolOffset);
+		if (pool.TypeAt(idx) != dart::ObjectPool::EntryType::kTaggedObject || pool.ObjectAt(idx).GetClassId() != dart::kTypeArgumentsCid)
+			continue;
+		if (app.TypeDb()->FindOrAdd(dart::TypeArguments::RawCast(pool.ObjectAt(idx))) == &type->Arguments()) {
+			ref = TypeRef{ TypeRef::FuturePool, asmText.poolOffset };
+			return true;
+		}
+	}
+	return false;
+}
+
+bool AnalysisCache::resolveTypeRef(const TypeRef& ref, DartType*& type)
+{
+	type = nullptr;
+	switch (ref.kind) {
+	case TypeRef::None:
+		return true;
+	case TypeRef::Class:
+		if (ref.key >= app.classes.size() || app.classes[ref.key] == nullptr)
+			return false;
+		type = app.classes[ref.key]->DeclarationType();
+		return type != nullptr;
+	case TypeRef::FutureNull:
+		type = app.TypeDb()->FindOrAdd(app.DartFutureCid(), &DartTypeArguments::Null);
+		return true;
+	case TypeRef::FuturePool: {
+		auto& pool = app.GetObjectPool();
+		const auto idx = dart::ObjectPool::IndexFromOffset(ref.key);
+		if (idx < 0 || idx >= pool.Length() || pool.TypeAt(idx) != dart::ObjectPool::EntryType::kTaggedObject ||
+			pool.ObjectAt(idx).GetClassId() != dart::kTypeArgumentsCid)
+			return false;
+		type = app.TypeDb()->FindOrAdd(app.DartFutureCid(), app.TypeDb()->FindOrAdd(dart::TypeArguments::RawCast(pool.ObjectAt(idx))));
+		return true;
+	}
+	}
+	return false;
+}
+
+std::string AnalysisCache::unlinkedCallStubAddress(uint64_t poolOffset)
+{
+	// IL text of UnlinkedCall has the stub address (offset from libapp base) but PoolObjectDigest() has only the stub name
+	// because it is also used for comparing builds. the stub might be moved in a new build.
+	auto& pool = app.GetObjectPool();
+	const auto idx = dart::ObjectPool::IndexFromOffset(poolOffset);
+	if (idx < 0 || idx + 1 >= pool.Length() || pool.TypeAt(idx) != dart::ObjectPool::EntryType::kTaggedObject ||
+		pool.ObjectAt(idx).GetClassId() != dart::kUnlinkedCallCid)
+		return "";
+	return std::format("@{:#x}", pool.RawValueAt(idx + 1) - app.base());
+}
+
+uint64_t AnalysisCache::dependencyHash(const std::vector<Dependency>& deps, uint64_t fnAddr)
+{
+	uint64_t hash = kFnvOffsetBasis;
+	for (const auto& dep : deps) {
+		std::string digest;
+		switch (dep.kind) {
+		case Dependency::PoolObject:
+			digest = app.PoolObjectDigest(dep.key);
+			digest += unlinkedCallStubAddress(dep.key);
+			break;
+		case Dependency::CallTarget: {
+			auto fn = app.GetFunction(fnAddr + dep.key);
+			if (fn)
+				digest = fn->FullName();
+			break;
+		}
+		case Dependency::Class:
+			if (dep.key < app.classes.size() && app.classes[dep.key])
+				digest = app.classes[dep.key]->FullName();
+			break;
+		}
+		hash = fnvHash(hash, &dep.kind, sizeof(dep.kind));
+		hash = fnvHash(hash, &dep.key, sizeof(dep.key));
+		// include the terminated null to separate each digest
+		hash = fnvHash(hash, digest.c_str(), digest.size() + 1);
+	}
+	return hash;
+}
+
+void AnalysisCache::load()
+{
+	std::ifstream is{ path, std::ios::binary };
+	if (!is)
+		return;
+
+	CacheReader reader{ is };
+	char magic[sizeof(kCacheMagic)];
+	for (auto& c : magic)
+		c = reader.Read<char>();
+	if (memcmp(magic, kCacheMagic, sizeof(kCacheMagic)) != 0)
+		throw std::runtime_error("not a cache file");
+	if (reader.Read<uint32_t>() != kCacheVersion || reader.Read<uint32_t>() != kAnalyzerVersion || reader.ReadString() != app.SnapshotHash())
+		throw std::runtime_error("cache file is created by another version of blutter");
+
+	const auto numRecords = reader.Read<uint64_t>();
+	records.reserve(numRecords);
+	for (uint64_t i = 0; i < numRecords; i++) {
+		Record rec;
+		rec.codeHash = reader.Read<uint64_t>();
+		rec.depHash = reader.Read<uint64_t>();
+
+		rec.asmTexts.resize(reader.Read<uint32_t>());
+		for (auto& asmText : rec.asmTexts) {
+			asmText.offset = reader.Read<uint32_t>();
+			asmText.dataType = reader.Read<uint8_t>();
+			const auto val = reader.Read<uint64_t>();
+			if (asmText.dataType == AsmText::Boolean)
+				asmText.boolVal = val != 0;
+			else
+				asmText.threadOffset = val;
+		}
+		if (rec.asmTexts.empty())
+			throw std::runtime_error("invalid record");
+		rec.firstStackLimitOffset = reader.Read<uint32_t>();
+		rec.maxParamStackOffset = reader.Read<int32_t>();
+
+		rec.deps.resize(reader.Read<uint32_t>());
+		for (auto& dep : rec.deps) {
+			dep.kind = (Dependency::Kind)reader.Read<uint8_t>();
+			dep.key = reader.Read<uint64_t>();
+		}
+
+		rec.ils.resize(reader.Read<uint32_t>());
+		for (auto& il : rec.ils) {
+			il.kind = reader.Read<uint8_t>();
+			il.start = reader.Read<uint32_t>();
+			il.end = reader.Read<uint32_t>();
+			il.hasAddr = reader.Read<uint8_t>() != 0;
+			il.addrOffset = reader.Read<int64_t>();
+			il.text = reader.ReadString();
+			il.textSuffix = reader.ReadString();
+		}
+
+		rec.structOperands.resize(reader.Read<uint32_t>());
+		for (auto& ref : rec.structOperands) {
+			ref.offset = reader.Read<uint32_t>();
+			ref.opIdx = reader.Read<uint8_t>();
+			ref.base = (StructOperandRef::Base)reader.Read<uint8_t>();
+		}
+
+		rec.params.resize(reader.Read<uint32_t>());
+		for (auto& param : rec.params) {
+			param.name = reader.ReadString();
+			param.type.kind = (TypeRef::Kind)reader.Read<uint8_t>();
+			param.type.key = reader.Read<uint64_t>();
+			param.paramOffset = reader.Read<int32_t>();
+			param.localOffset = reader.Read<int32_t>();
+			param.paramReg = reader.Read<int32_t>();
+			param.valReg = reader.Read<int32_t>();
+			param.valText = reader.ReadString();
+		}
+		rec.numFixedParam = reader.Read<uint8_t>();
+		rec.isNamedParam = reader.Read<uint8_t>() != 0;
+		rec.returnType.kind = (TypeRef::Kind)reader.Read<uint8_t>();
+		rec.returnType.key = reader.Read<uint64_t>();
+		rec.stackSize = reader.Read<uint32_t>();
+
+		records.emplace(rec.codeHash, std::move(rec));
+	}
+}
+
+void AnalysisCache::Save()
+{
+	// loaded records that are not used in this run (filtered out or functions of another app with same Dart version) are kept.
+	// records of this run are first, so they are kept when both have same key.
+	newRecords.reserve(newRecords.size() + records.size());
+	for (auto& [codeHash, rec] : records)
+		newRecords.push_back(std::move(rec));
+	records.clear();
+
+	// same function code might be in many places. keep only one record.
+	std::stable_sort(newRecords.begin(), newRecords.end(), [](const Record& a, const Record& b) {
+		return a.codeHash < b.codeHash || (a.codeHash == b.codeHash && a.depHash < b.depHash);
+	});
+	auto dupStart = std::unique(newRecords.begin(), newRecords.end(), [](const Record& a, const Record& b) {
+		return a.codeHash == b.codeHash && a.depHash == b.depHash;
+	});
+	newRecords.erase(dupStart, newRecords.end());
+
+	std::filesystem::create_directories(path.parent_path());
+	// write to temporary file first. a broken cache file is never left if blutter is killed.
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream os{ tmpPath, std::ios::binary };
+		if (!os)
+			throw std::runtime_error(std::format("Cannot create cache file {}", tmpPath.string()));
+
+		CacheWriter writer{ os };
+		for (auto c : kCacheMagic)
+			writer.Write(c);
+		writer.Write(kCacheVersion);
+		writer.Write(kAnalyzerVersion);
+		writer.WriteString(app.SnapshotHash());
+
+		writer.Write((uint64_t)newRecords.size());
+		for (const auto& rec : newRecords) {
+			writer.Write(rec.codeHash);
+			writer.Write(rec.depHash);
+
+			writer.Write((uint32_t)rec.asmTexts.size());
+			for (const auto& asmText : rec.asmTexts) {
+				writer.Write(asmText.offset);
+				writer.Write(asmText.dataType);
+				switch (asmText.dataType) {
+				case AsmText::None:
+					writer.Write((uint64_t)0);
+					break;
+				case AsmText::Boolean:
+					writer.Write((uint64_t)asmText.boolVal);
+					break;
+				default:
+					writer.Write(asmText.threadOffset);
+					break;
+				}
+			}
+			writer.Write(rec.firstStackLimitOffset);
+			writer.Write(rec.maxParamStackOffset);
+
+			writer.Write((uint32_t)rec.deps.size());
+			for (const auto& dep : rec.deps) {
+				writer.Write((uint8_t)dep.kind);
+				writer.Write(dep.key);
+			}
+
+			writer.Write((uint32_t)rec.ils.size());
+			for (const auto& il : rec.ils) {
+				writer.Write(il.kind);
+				writer.Write(il.start);
+				writer.Write(il.end);
+				writer.Write((uint8_t)il.hasAddr);
+				writer.Write(il.addrOffset);
+				writer.WriteString(il.text);
+				writer.WriteString(il.textSuffix);
+			}
+
+			writer.Write((uint32_t)rec.structOperands.size());
+			for (const auto& ref : rec.structOperands) {
+				writer.Write(ref.offset);
+				writer.Write(ref.opIdx);
+				writer.Write((uint8_t)ref.base);
+			}
+
+			writer.Write((uint32_t)rec.params.size());
+			for (const auto& param : rec.params) {
+				writer.WriteString(param.name);
+				writer.Write((uint8_t)param.type.kind);
+				writer.Write(param.type.key);
+				writer.Write(param.paramOffset);
+				writer.Write(param.localOffset);
+				writer.Write(param.paramReg);
+				writer.Write(param.valReg);
+				writer.WriteString(param.valText);
+			}
+			writer.Write(rec.numFixedParam);
+			writer.Write((uint8_t)rec.isNamedParam);
+			writer.Write((uint8_t)rec.returnType.kind);
+			writer.Write(rec.returnType.key);
+			writer.Write(rec.stackSize);
+		}
+		if (!os.flush())
+			throw std::runtime_error(std::format("Cannot write cache file {}", tmpPath.string()));
+	}
+	std::filesystem::rename(tmpPath, path);
+}
+
+#endif // NO_CODE_ANALYSIS
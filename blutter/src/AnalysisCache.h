@@ -0,0 +1,111 @@
+#pragma once
+#include "CodeAnalyzer.h"
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+
+class DartApp;
+class DartFunction;
+
+// On-disk cache of function analysis results (IL, parameters and assembly annotations) for analyzing successive builds of same app.
+// There is one cache file per Dart snapshot hash. A record is looked up by hash of the function code bytes. It is used only
+// when the objects that the function refers to (Object Pool entries, call targets, allocated classes) are still the same.
+// Addresses are stored relative to the function entry point, so a moved function can use the record too.
+class AnalysisCache
+{
+public:
+	// load cache file of the app from cacheDir. no or invalid cache file is same as empty cache.
+	AnalysisCache(DartApp& app, std::filesystem::path cacheDir);
+	AnalysisCache() = delete;
+	AnalysisCache(const AnalysisCache&) = delete;
+	AnalysisCache(AnalysisCache&&) = delete;
+	AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+	static uint64_t HashCode(const uint8_t* code, size_t size);
+
+	// set analyzed data of the function from cache. returns false when there is no valid record.
+	bool Restore(DartFunction& dartFn, uint64_t codeHash);
+	// keep analyzed data of the function for Save()
+	void Add(DartFunction& dartFn, uint64_t codeHash);
+	// write all loaded and added records to cache file (replace the old file). Restore() cannot be used after it.
+	void Save();
+
+	uint64_t NumHits() const { return numHits; }
+	uint64_t NumMisses() const { return numMisses; }
+
+private:
+	struct Dependency {
+		enum Kind : uint8_t {
+			PoolObject,
+			CallTarget,
+			Class,
+		};
+		Kind kind;
+		uint64_t key; // pool offset, call target offset from entry point, class id
+	};
+
+	// type in analysis result (parameter and return type) that can be found again in another run
+	struct TypeRef {
+		enum Kind : uint8_t {
+			None,
+			Class, // declaration type of class. key is class id
+			FutureNull, // Future<Null>
+			FuturePool, // Future with type arguments in Object Pool. key is pool offset
+		};
+		Kind kind;
+		uint64_t key;
+	};
+
+	struct ParamRecord {
+		std::string name;
+		TypeRef type;
+		int32_t paramOffset;
+		int32_t localOffset;
+		int32_t paramReg;
+		int32_t valReg;
+		std::string valText;
+	};
+
+	struct ILRecord {
+		uint8_t kind;
+		uint32_t start; // offset from entry point
+		uint32_t end;
+		// some IL text contains an absolute address. the text is split at the address.
+		bool hasAddr;
+		int64_t addrOffset; // offset from entry point
+		std::string text;
+		std::string textSuffix;
+	};
+
+	struct Record {
+		uint64_t codeHash;
+		uint64_t depHash;
+		std::vector<AsmText> asmTexts; // call address is offset from entry point
+		uint32_t firstStackLimitOffset; // offset from entry point + 1. 0 means no stack limit check.
+		int32_t maxParamStackOffset;
+		std::vector<Dependency> deps;
+		std::vector<ILRecord> ils;
+		std::vector<StructOperandRef> structOperands;
+		std::vector<ParamRecord> params;
+		uint8_t numFixedParam;
+		bool isNamedParam;
+		TypeRef returnType;
+		uint32_t stackSize;
+	};
+
+	// returns false if the type cannot be referred from another run
+	bool makeTypeRef(DartType* type, const AnalyzedFnData& fnInfo, TypeRef& ref);
+	// returns false if the referred type does not exist
+	bool resolveTypeRef(const TypeRef& ref, DartType*& type);
+	std::string unlinkedCallStubAddress(uint64_t poolOffset);
+	uint64_t dependencyHash(const std::vector<Dependency>& deps, uint64_t fnAddr);
+	void load();
+
+	DartApp& app;
+	std::filesystem::path path;
+	std::unordered_multimap<uint64_t, Record> records; // read only after loading
+	std::mutex newRecordsMutex;
+	std::vector<Record> newRecords;
+	std::atomic<uint64_t> numHits{ 0 };
+	std::atomic<uint64_t> numMisses{ 0 };
+};
@@ -0,0 +1,360 @@
+#include "pch.h"
+#include "AppFingerprint.h"
+#include "DartApp.h"
+#include "Disassembler.h"
+#include "WorkerPool.h"
+#include <fstream>
+
+static constexpr char kFingerprintMagic[] = "blutter-fingerprint 2";
+
+static constexpr uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+static constexpr uint64_t kFnvPrime = 0x100000001b3ULL;
+
+class FnvHasher
+{
+public:
+	template <typename T>
+	void Add(T val) {
+		static_assert(std::is_trivially_copyable_v<T>);
+		addBytes(&val, sizeof(T));
+	}
+	void AddString(const std::string& s) {
+		// include the terminated null to separate each string
+		addBytes(s.c_str(), s.size() + 1);
+	}
+	uint64_t Value() const { return hash; }
+
+private:
+	void addBytes(const void* data, size_t size) {
+		auto ptr = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= ptr[i];
+			hash *= kFnvPrime;
+		}
+	}
+
+	uint64_t hash{ kFnvOffsetBasis };
+};
+
+AppFingerprint::AppFingerprint(DartApp& app, unsigned numJobs)
+{
+	std::vector<DartFunction*> fns;
+	for (auto lib : app.libs) {
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				if (dartFn->Size() != 0)
+					fns.push_back(dartFn);
+			}
+		}
+	}
+
+	std::vector<uint64_t> fnHashes(fns.size());
+	std::vector<std::unique_ptr<Disassembler>> disasmers;
+	for (unsigned i = 0; i < std::max(numJobs, 1u); i++)
+		disasmers.push_back(std::make_unique<Disassembler>());
+	WorkerPool::ParallelFor(numJobs, fns.size(), [&](unsigned workerId, size_t idx) {
+		fnHashes[idx] = fingerprintFunction(app, *disasmers[workerId], *fns[idx]);
+	});
+
+	std::unordered_map<DartFunction*, uint64_t> hashOfFn;
+	functions.reserve(fns.size());
+	for (size_t i = 0; i < fns.size(); i++) {
+		functions.push_back(Entry{ fns[i]->FullName(), fnHashes[i] });
+		hashOfFn[fns[i]] = fnHashes[i];
+	}
+
+	// a class is changed when its layout, its parent or any of its functions is changed
+	for (auto lib : app.libs) {
+		for (auto cls : lib->classes) {
+			FnvHasher hasher;
+			hasher.AddString(cls->Parent() ? cls->Parent()->FullName() : "");
+			hasher.Add(cls->Size());
+			for (auto field : cls->Fields()) {
+				hasher.AddString(field->Name());
+				hasher.Add(field->Offset());
+				hasher.Add(field->IsStatic());
+			}
+			std::vector<Entry> members;
+			for (auto dartFn : cls->Functions()) {
+				auto itr = hashOfFn.find(dartFn);
+				members.push_back(Entry{ dartFn->Name(), itr != hashOfFn.end() ? itr->second : 0 });
+			}
+			std::sort(members.begin(), members.end(), [](const Entry& a, const Entry& b) {
+				return a.name < b.name || (a.name == b.name && a.hash < b.hash);
+			});
+			for (const auto& member : members) {
+				hasher.AddString(member.name);
+				hasher.Add(member.hash);
+			}
+			classes.push_back(Entry{ std::format("[{}] {}", lib->url, cls->FullName()), hasher.Value() });
+		}
+	}
+
+	auto byNameHash = [](const Entry& a, const Entry& b) {
+		return a.name < b.name || (a.name == b.name && a.hash < b.hash);
+	};
+	std::sort(functions.begin(), functions.end(), byNameHash);
+	std::sort(classes.begin(), classes.end(), byNameHash);
+}
+
+AppFingerprint::AppFingerprint(const std::filesystem::path& path)
+{
+	std::ifstream is{ path };
+	std::string line;
+	if (!std::getline(is, line) || line != kFingerprintMagic)
+		throw std::runtime_error(std::format("{} is not a fingerprint file", path.string()));
+
+	while (std::getline(is, line)) {
+		// line format: "<F|C> <hash in hex> <name>"
+		if (line.size() < 20 || line[1] != ' ' || line[18] != ' ')
+			throw std::runtime_error(std::format("invalid fingerprint line: {}", line));
+		Entry entry{ line.substr(19), std::stoull(line.substr(2, 16), nullptr, 16) };
+		if (line[0] == 'F')
+			functions.push_back(std::move(entry));
+		else if (line[0] == 'C')
+			classes.push_back(std::move(entry));
+	}
+}
+
+void AppFingerprint::Save(const std::filesystem::path& path) const
+{
+	std::ofstream of{ path };
+	if (!of)
+		throw std::runtime_error(std::format("Cannot create fingerprint file {}", path.string()));
+	of << kFingerprintMagic << '\n';
+	for (const auto& entry : classes)
+		of << std::format("C {:016x} {}\n", entry.hash, entry.name);
+	for (const auto& entry : functions)
+		of << std::format("F {:016x} {}\n", entry.hash, entry.name);
+}
+
+// entries of both lists must be sorted by name then hash.
+// entries with same name are matched by hash first. unmatched entries are paired as changed entries.
+static void diffEntries(const auto& oldEntries, const auto& newEntries, std::vector<const std::string*>& changed,
+	auto&& onAdded, auto&& onRemoved)
+{
+	size_t i = 0, j = 0;
+	std::vector<size_t> oldRest, newRest;
+	while (i < oldEntries.size() || j < newEntries.size()) {
+		const std::string& name = (j >= newEntries.size() || (i < oldEntries.size() && oldEntries[i].name < newEntries[j].name)) ?
+			oldEntries[i].name : newEntries[j].name;
+		auto oldEnd = i;
+		while (oldEnd < oldEntries.size() && oldEntries[oldEnd].name == name)
+			oldEnd++;
+		auto newEnd = j;
+		while (newEnd < newEntries.size() && newEntries[newEnd].name == name)
+			newEnd++;
+
+		oldRest.clear();
+		newRest.clear();
+		while (i < oldEnd || j < newEnd) {
+			if (j >= newEnd || (i < oldEnd && oldEntries[i].hash < newEntries[j].hash))
+				oldRest.push_back(i++);
+			else if (i >= oldEnd || newEntries[j].hash < oldEntries[i].hash)
+				newRest.push_back(j++);
+			else {
+				i++;
+				j++;
+			}
+		}
+
+		const auto numChanged = std::min(oldRest.size(), newRest.size());
+		for (size_t k = 0; k < numChanged; k++)
+			changed.push_back(&newEntries[newRest[k]].name);
+		for (size_t k = numChanged; k < newRest.size(); k++)
+			onAdded(newRest[k]);
+		for (size_t k = numChanged; k < oldRest.size(); k++)
+			onRemoved(oldRest[k]);
+	}
+}
+
+AppFingerprint::DiffSummary AppFingerprint::Diff(const AppFingerprint& oldFp, const AppFingerprint& newFp, std::ostream& of)
+{
+	std::vector<const std::string*> addedClasses, removedClasses, changedClasses;
+	diffEntries(oldFp.classes, newFp.classes, changedClasses,
+		[&](size_t idx) { addedClasses.push_back(&newFp.classes[idx].name); },
+		[&](size_t idx) { removedClasses.push_back(&oldFp.classes[idx].name); });
+
+	std::vector<size_t> addedFnIdxs, removedFnIdxs;
+	std::vector<const std::string*> addedFns, removedFns, changedFns;
+	diffEntries(oldFp.functions, newFp.functions, changedFns,
+		[&](size_t idx) { addedFnIdxs.push_back(idx); },
+		[&](size_t idx) { removedFnIdxs.push_back(idx); });
+
+	// an added function that has same code as a removed function is renamed or moved function
+	std::unordered_multimap<uint64_t, size_t> removedByHash;
+	for (auto idx : removedFnIdxs)
+		removedByHash.emplace(oldFp.functions[idx].hash, idx);
+	std::vector<std::pair<const std::string*, const std::string*>> renamedFns;
+	for (auto idx : addedFnIdxs) {
+		auto itr = removedByHash.find(newFp.functions[idx].hash);
+		if (itr != removedByHash.end()) {
+			renamedFns.emplace_back(&oldFp.functions[itr->second].name, &newFp.functions[idx].name);
+			removedByHash.erase(itr);
+		}
+		else {
+			addedFns.push_back(&newFp.functions[idx].name);
+		}
+	}
+	for (auto idx : removedFnIdxs) {
+		const auto hash = oldFp.functions[idx].hash;
+		auto [first, last] = removedByHash.equal_range(hash);
+		if (std::any_of(first, last, [idx](const auto& item) { return item.second == idx; }))
+			removedFns.push_back(&oldFp.functions[idx].name);
+	}
+
+	DiffSummary summary{
+		.addedClasses = addedClasses.size(),
+		.removedClasses = removedClasses.size(),
+		.changedClasses = changedClasses.size(),
+		.addedFunctions = addedFns.size(),
+		.removedFunctions = removedFns.size(),
+		.changedFunctions = changedFns.size(),
+		.renamedFunctions = renamedFns.size(),
+	};
+
+	of << std::format("# classes: {} added, {} removed, {} changed\n", summary.addedClasses, summary.removedClasses, summary.changedClasses);
+	of << std::format("# functions: {} added, {} removed, {} changed, {} renamed\n", summary.addedFunctions, summary.removedFunctions,
+		summary.changedFunctions, summary.renamedFunctions);
+	for (auto name : addedClasses)
+		of << "+ class " << *name << '\n';
+	for (auto name : removedClasses)
+		of << "- class " << *name << '\n';
+	for (auto name : changedClasses)
+		of << "* class " << *name << '\n';
+	for (auto name : addedFns)
+		of << "+ " << *name << '\n';
+	for (auto name : removedFns)
+		of << "- " << *name << '\n';
+	for (auto name : changedFns)
+		of << "* " << *name << '\n';
+	for (auto& [oldName, newName] : renamedFns)
+		of << "> " << *oldName << " => " << *newName << '\n';
+
+	return summary;
+}
+
+#ifdef TARGET_ARCH_ARM64
+static bool isPcRelative(const cs_insn* insn, uint8_t opIdx)
+{
+	// the target address is always the last operand
+	if (opIdx != insn->detail->arm64.op_count - 1)
+		return false;
+	switch (insn->id) {
+	case ARM64_INS_B:
+	case ARM64_INS_BL:
+	case ARM64_INS_CBZ:
+	case ARM64_INS_CBNZ:
+	case ARM64_INS_TBZ:
+	case ARM64_INS_TBNZ:
+	case ARM64_INS_ADR:
+	case ARM64_INS_ADRP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint64_t AppFingerprint::fingerprintFunction(DartApp& app, Disassembler& disasmer, DartFunction& dartFn)
+{
+	const auto fnAddr = dartFn.Address();
+	const auto fnEnd = fnAddr + dartFn.Size();
+	auto asm_insns = disasmer.Disasm((uint8_t*)dartFn.MemAddress(), dartFn.Size(), fnAddr);
+
+	FnvHasher hasher;
+	auto addPoolObject = [&](int64_t offset, bool isPair) {
+		hasher.AddString(app.PoolObjectDigest(offset));
+		if (isPair)
+			hasher.AddString(app.PoolObjectDigest(offset + dart::kWordSize));
+	};
+
+	// large Object Pool offset is loaded with "add tmp, PP, #high, lsl #12" then "ldr reg, [tmp, #low]"
+	arm64_reg poolBaseReg = ARM64_REG_INVALID;
+	int64_t poolBase = 0;
+	for (size_t i = 0; i < asm_insns.Count(); i++) {
+		auto insn = asm_insns.Ptr(i);
+		const auto& detail = insn->detail->arm64;
+		hasher.Add(insn->id);
+
+		const bool isPair = insn->id == ARM64_INS_LDP || insn->id == ARM64_INS_STP;
+		auto nextPoolBaseReg = ARM64_REG_INVALID;
+		for (uint8_t j = 0; j < detail.op_count; j++) {
+			const auto& op = detail.operands[j];
+			hasher.Add(op.type);
+			hasher.Add(op.vas);
+			hasher.Add(op.vector_index);
+			switch (op.type) {
+			case ARM64_OP_REG:
+				hasher.Add(op.reg);
+				break;
+			case ARM64_OP_IMM:
+				if (isPcRelative(insn, j)) {
+					const auto target = (uint64_t)op.imm;
+					if (target >= fnAddr && target < fnEnd) {
+						hasher.Add(target - fnAddr);
+					}
+					else {
+						auto fn = app.GetFunction(target);
+						hasher.AddString(fn ? fn->FullName() : "");
+					}
+				}
+				else if (insn->id == ARM64_INS_ADD && j == 2 && detail.operands[1].type == ARM64_OP_REG && detail.operands[1].reg == CSREG_DART_PP) {
+					poolBase = op.imm << op.shift.value;
+					nextPoolBaseReg = detail.operands[0].reg;
+				}
+				else if (insn->id == ARM64_INS_ADD && j == 2 && poolBaseReg != ARM64_REG_INVALID && detail.operands[1].reg == poolBaseReg) {
+					// address of 2 Object Pool entries (UnlinkedCall and its entry point)
+					addPoolObject(poolBase + op.imm, true);
+				}
+				else {
+					hasher.Add(op.imm);
+					hasher.Add(op.shift.type);
+					hasher.Add(op.shift.value);
+				}
+				break;
+			case ARM64_OP_MEM:
+				hasher.Add(op.mem.index);
+				if (op.mem.base == CSREG_DART_PP && op.mem.index == ARM64_REG_INVALID) {
+					addPoolObject(op.mem.disp, isPair);
+				}
+				else if (poolBaseReg != ARM64_REG_INVALID && op.mem.base == poolBaseReg) {
+					addPoolObject(poolBase + op.mem.disp, isPair);
+				}
+				else {
+					hasher.Add(op.mem.base);
+					hasher.Add(op.mem.disp);
+				}
+				break;
+			case ARM64_OP_FP:
+				hasher.Add(op.fp);
+				break;
+			case ARM64_OP_CIMM:
+				hasher.Add(op.imm);
+				break;
+			case ARM64_OP_REG_MRS:
+			case ARM64_OP_REG_MSR:
+				hasher.Add(op.reg);
+				break;
+			case ARM64_OP_PSTATE:
+				hasher.Add(op.pstate);
+				break;
+			case ARM64_OP_SYS:
+				hasher.Add(op.sys);
+				break;
+			case ARM64_OP_PREFETCH:
+				hasher.Add(op.prefetch);
+				break;
+			case ARM64_OP_BARRIER:
+				hasher.Add(op.barrier);
+				break;
+			default:
+				// only the operand type. the whole struct has padding and unused union bytes.
+				break;
+			}
+		}
+		poolBaseReg = nextPoolBaseReg;
+	}
+
+	return hasher.Value();
+}
+#endif // TARGET_ARCH_ARM64
@@ -0,0 +1,53 @@
+#pragma once
+#include <filesystem>
+#include <unordered_map>
+
+class DartApp;
+class DartFunction;
+class Disassembler;
+
+// Fingerprints of all functions and classes in an app for finding what is changed between two builds.
+// A function fingerprint is hash of its normalized instructions. Branch targets inside the function are offsets from
+// entry point, call targets are function names and Object Pool entries are the object descriptions, so address shifts
+// do not change the fingerprint.
+class AppFingerprint
+{
+public:
+	// fingerprint all functions of loaded app. must be in DartApp scope.
+	AppFingerprint(DartApp& app, unsigned numJobs = 1);
+	// load fingerprints written by Save()
+	explicit AppFingerprint(const std::filesystem::path& path);
+	AppFingerprint() = delete;
+	AppFingerprint(const AppFingerprint&) = delete;
+	AppFingerprint(AppFingerprint&&) = default;
+	AppFingerprint& operator=(const AppFingerprint&) = delete;
+
+	void Save(const std::filesystem::path& path) const;
+
+	struct DiffSummary {
+		size_t addedClasses{ 0 };
+		size_t removedClasses{ 0 };
+		size_t changedClasses{ 0 };
+		size_t addedFunctions{ 0 };
+		size_t removedFunctions{ 0 };
+		size_t changedFunctions{ 0 };
+		size_t renamedFunctions{ 0 }; // same code with different name
+	};
+	// write added, removed and changed classes and functions from oldFp to newFp
+	static DiffSummary Diff(const AppFingerprint& oldFp, const AppFingerprint& newFp, std::ostream& of);
+
+	size_t NumFunctions() const { return functions.size(); }
+	size_t NumClasses() const { return classes.size(); }
+
+private:
+	struct Entry {
+		std::string name;
+		uint64_t hash;
+	};
+
+	static uint64_t fingerprintFunction(DartApp& app, Disassembler& disasmer, DartFunction& dartFn);
+
+	// closures in a class might have same name. entries are sorted by name.
+	std::vector<Entry> functions;
+	std::vector<Entry> classes;
+};
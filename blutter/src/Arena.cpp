@@ -0,0 +1,68 @@
+#include "pch.h"
+#include "Arena.h"
+
+thread_local Arena* Arena::current = nullptr;
+
+// chunk size is doubled until this size. a bigger allocation gets its own chunk.
+static constexpr size_t MaxChunkSize = 1024 * 1024;
+// a scoped allocation is prefixed with a header telling where the memory comes from (keep max alignment)
+static constexpr size_t ScopedHeaderSize = alignof(std::max_align_t);
+static constexpr uintptr_t FromHeap = 0;
+static constexpr uintptr_t FromArena = 1;
+
+Arena::~Arena()
+{
+	// destroy objects in reverse order of construction
+	for (auto node = dtors; node; node = node->next)
+		node->dtor(node->obj);
+	while (chunks) {
+		auto next = chunks->next;
+		::operator delete(chunks);
+		chunks = next;
+	}
+}
+
+void* Arena::allocateSlow(size_t size, size_t align)
+{
+	const auto needed = sizeof(Chunk) + size + align;
+	auto chunkSize = nextChunkSize;
+	while (chunkSize < needed)
+		chunkSize *= 2;
+	if (nextChunkSize < MaxChunkSize)
+		nextChunkSize *= 2;
+
+	auto chunk = (Chunk*)::operator new(chunkSize);
+	chunk->next = chunks;
+	chunks = chunk;
+	totalSize += chunkSize;
+	cur = (uintptr_t)(chunk + 1);
+	end = (uintptr_t)chunk + chunkSize;
+
+	auto p = (cur + align - 1) & ~(align - 1);
+	cur = p + size;
+	return (void*)p;
+}
+
+void* Arena::AllocateScoped(size_t size)
+{
+	uint8_t* p;
+	if (current) {
+		p = (uint8_t*)current->Allocate(ScopedHeaderSize + size, ScopedHeaderSize);
+		*(uintptr_t*)p = FromArena;
+	}
+	else {
+		p = (uint8_t*)::operator new(ScopedHeaderSize + size);
+		*(uintptr_t*)p = FromHeap;
+	}
+	return p + ScopedHeaderSize;
+}
+
+void Arena::FreeScoped(void* p) noexcept
+{
+	if (p == nullptr)
+		return;
+	auto header = (uint8_t*)p - ScopedHeaderSize;
+	// arena memory is released with the arena
+	if (*(uintptr_t*)header == FromHeap)
+		::operator delete(header);
+}
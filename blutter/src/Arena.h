@@ -0,0 +1,81 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Bump allocator for objects that die together (all types of an app, all ILs and values of a function).
+// Memory is returned only when the arena is destroyed, so an allocation is just a pointer increment.
+// An arena is not thread safe. The owner must serialize allocations.
+class Arena
+{
+public:
+	explicit Arena(size_t firstChunkSize = 4096) : nextChunkSize(firstChunkSize) {}
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena(Arena&&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+		auto p = (cur + align - 1) & ~(align - 1);
+		if (p + size > end)
+			return allocateSlow(size, align);
+		cur = p + size;
+		return (void*)p;
+	}
+
+	// construct an object in the arena. its destructor (if any) is called when the arena is destroyed.
+	template <typename T, typename... Args>
+	T* New(Args&&... args) {
+		auto obj = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			dtors = new (Allocate(sizeof(DtorNode), alignof(DtorNode))) DtorNode{ dtors, obj, [](void* p) { static_cast<T*>(p)->~T(); } };
+		}
+		return obj;
+	}
+
+	// total size of chunks
+	size_t Size() const { return totalSize; }
+
+	// While a scope is alive, AllocateScoped() on this thread takes memory from the arena.
+	// Classes with class-level operator new/delete using AllocateScoped()/FreeScoped() (ILInstr and VarValue) are
+	// allocated in the arena of the function being analyzed without changing their owners (std::unique_ptr).
+	class Scope {
+	public:
+		explicit Scope(Arena& arena) : prev(current) { current = &arena; }
+		~Scope() { current = prev; }
+		Scope() = delete;
+		Scope(const Scope&) = delete;
+		Scope(Scope&&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		Arena* prev;
+	};
+
+	// an object allocated without a scope is taken from the heap. FreeScoped() frees only heap memory.
+	static void* AllocateScoped(size_t size);
+	static void FreeScoped(void* p) noexcept;
+
+private:
+	struct Chunk {
+		Chunk* next;
+	};
+	struct DtorNode {
+		DtorNode* next;
+		void* obj;
+		void (*dtor)(void*);
+	};
+
+	void* allocateSlow(size_t size, size_t align);
+
+	uintptr_t cur{ 0 };
+	uintptr_t end{ 0 };
+	size_t nextChunkSize;
+	size_t totalSize{ 0 };
+	Chunk* chunks{ nullptr };
+	DtorNode* dtors{ nullptr };
+
+	static thread_local Arena* current;
+};
@@ -1,38 +1,142 @@
 #include "pch.h"
 #include "CodeAnalyzer.h"
+#include "AnalysisCache.h"
+#include "CodeFilter.h"
 #include "DartApp.h"
+#include "WorkerPool.h"
 
 #ifndef NO_CODE_ANALYSIS
 
 AnalyzedFnData::AnalyzedFnData(DartApp& app, DartFunction& dartFn, AsmTexts asmTexts)
-	: app(app), dartFn(dartFn), asmTexts(std::move(asmTexts))
+	: app(app), dartFn(dartFn), asmTexts(std::move(asmTexts)), ils(dartFn.Address())
 {
 }
 
-void CodeAnalyzer::AnalyzeAll()
+Arena& AnalyzedFnData::BeginIL()
 {
-	Disassembler disasmer;
+	scratch = std::make_unique<Arena>(2048);
+	return *scratch;
+}
+
+size_t AnalyzedFnData::FinishIL()
+{
+	ils.Reserve(il_insns.size());
+	for (auto& il : il_insns)
+		ils.Add(il->Kind(), il->Range(), il->ToString());
+	il_insns.clear();
+	il_insns.shrink_to_fit();
+	// no value may point into the scratch arena after it is released
+	for (auto& param : params.params) {
+		if (param.val) {
+			param.valText = param.val->ToString();
+			param.val.reset();
+		}
+	}
+	// AnalyzingVars and AnalyzingState are leaked (not destroyed) by DestroyVars()/DestroyState()
+	const auto size = scratch ? scratch->Size() : 0;
+	scratch.reset();
+	return size;
+}
 
+void CodeAnalyzer::AnalyzeAll()
+{
+	std::vector<DartFunction*> fns;
 	for (auto lib : app.libs) {
-		if (lib->isInternal)
+		if (lib->isInternal || (filter && !filter->MatchLibrary(*lib)))
 			continue;
 		for (auto cls : lib->classes) {
+			if (filter && !filter->MatchClass(*cls))
+				continue;
 			for (auto dartFn : cls->Functions()) {
-				if (dartFn->Size() == 0)
+				if (dartFn->Size() == 0 || dartFn->GetAnalyzedData() != nullptr || (filter && !filter->MatchFunction(*dartFn)))
 					continue;
+				fns.push_back(dartFn);
+			}
+		}
+	}
 
-				// start from PayloadAddress or Address?
-				// the assemblies will be deleted after finish analysis because assembly with details consume too much memory
-				auto asm_insns = disasmer.Disasm((uint8_t*)dartFn->MemAddress(), dartFn->Size(), dartFn->Address());
+	if (numJobs > 1) {
+		// start big functions first, so no worker is left with a big function at the end
+		std::stable_sort(fns.begin(), fns.end(), [](const DartFunction* fn1, const DartFunction* fn2) {
+			return fn1->Size() > fn2->Size();
+		});
+	}
 
-				dartFn->SetAnalyzedData(std::make_unique<AnalyzedFnData>(app, *dartFn, convertAsm(asm_insns)));
+	// capstone handle cannot be shared between threads
+	std::unique_ptr<Disassembler[]> disasmers{ new Disassembler[std::max(numJobs, 1u)] };
+	WorkerPool::ParallelFor(numJobs, fns.size(), [&](unsigned workerId, size_t idx) {
+		analyzeFunction(disasmers[workerId], fns[idx]);
+	});
+}
 
-				asm2il(dartFn, asm_insns);
-			}
+void CodeAnalyzer::AnalyzeLibrary(DartLibrary& lib)
+{
+	// a library is analyzed on the calling thread. it might be a worker of dumping code.
+	Disassembler disasmer;
+	for (auto cls : lib.classes) {
+		if (filter && !filter->MatchClass(*cls))
+			continue;
+		for (auto dartFn : cls->Functions()) {
+			if (dartFn->Size() == 0 || (filter && !filter->MatchFunction(*dartFn)))
+				continue;
+			analyzeFunction(disasmer, dartFn);
 		}
 	}
 }
 
+void CodeAnalyzer::AnalyzeFunction(DartFunction& dartFn)
+{
+	Disassembler disasmer;
+	analyzeFunction(disasmer, &dartFn);
+}
+
+void CodeAnalyzer::ReleaseLibrary(DartLibrary& lib)
+{
+	for (auto cls : lib.classes) {
+		for (auto dartFn : cls->Functions()) {
+			dartFn->ReleaseAnalyzedData();
+		}
+	}
+}
+
+void CodeAnalyzer::analyzeFunction(Disassembler& disasmer, DartFunction* dartFn)
+{
+	uint64_t codeHash = 0;
+	if (cache) {
+		codeHash = AnalysisCache::HashCode((const uint8_t*)dartFn->MemAddress(), dartFn->Size());
+		if (cache->Restore(*dartFn, codeHash)) {
+			auto fnInfo = dartFn->GetAnalyzedData();
+			numFunctions++;
+			numInstructions += fnInfo->asmTexts.Data().size();
+			numILs += fnInfo->ils.Size();
+			ilStreamBytes += fnInfo->ils.MemorySize();
+			return;
+		}
+	}
+
+	// start from PayloadAddress or Address?
+	// the assemblies will be deleted after finish analysis because assembly with details consume too much memory
+	auto asm_insns = disasmer.Disasm((uint8_t*)dartFn->MemAddress(), dartFn->Size(), dartFn->Address());
+
+	dartFn->SetAnalyzedData(std::make_unique<AnalyzedFnData>(app, *dartFn, convertAsm(asm_insns)));
+	auto fnInfo = dartFn->GetAnalyzedData();
+	// record operands for IDA struct offset here, so Dump4Ida does not need to disassemble the function again
+	dartFn->SetStructOperands(FindStructOperands(asm_insns));
+
+	{
+		Arena::Scope arenaScope{ fnInfo->BeginIL() };
+		asm2il(dartFn, asm_insns);
+		if (cache)
+			cache->Add(*dartFn, codeHash);
+	}
+	ilArenaBytes += fnInfo->FinishIL();
+
+	numFunctions++;
+	numInstructions += asm_insns.Count();
+	numILs += fnInfo->ils.Size();
+	ilStreamBytes += fnInfo->ils.MemorySize();
+}
+
 #endif // NO_CODE_ANALYSIS
 
 std::string FnParamInfo::ToString() const
@@ -40,9 +144,9 @@ std::string FnParamInfo::ToString() const
 	std::string txt = type ? type->ToString() : "dynamic";
 	txt += ' ';
 	txt += name.empty() ? "_" : name;
-	if (val) {
+	if (HasValue()) {
 		txt += " = ";
-		txt += val->ToString();
+		txt += ValueText();
 	}
 	if (valReg.IsSet() || localOffset) {
 		txt += " /* ";
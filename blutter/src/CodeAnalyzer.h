@@ -2,11 +2,17 @@
 #include "Disassembler.h"
 #include "il.h"
 #include <array>
+#include <atomic>
 
 // forward declaration
+class AnalysisCache;
+class CodeFilter;
 class DartApp;
 class DartFunction;
+class DartLibrary;
 
+// compact record of an assembly instruction with annotation data.
+// the assembly text is not kept here. it is rendered from instruction bytes when dumping (see RenderAsmText()).
 struct AsmText {
 	enum DataType : uint8_t {
 		None,
@@ -16,8 +22,7 @@ struct AsmText {
 		Call,
 	};
 
-	uint64_t addr;
-	char text[71]; // first 16 bytes are for mnemonic and spaces, after that is operands
+	uint32_t offset; // offset from first instruction of function
 	uint8_t dataType;
 	union {
 		uint64_t threadOffset;
@@ -29,18 +34,21 @@ struct AsmText {
 
 class AsmTexts {
 public:
-	AsmTexts(std::vector<AsmText> asm_texts, uint64_t first_stack_limit_addr, int max_param_stack_offset)
-		: first_addr{ asm_texts.front().addr }, last_addr{ asm_texts.back().addr }, first_stack_limit_addr{ first_stack_limit_addr }, 
+	AsmTexts(std::vector<AsmText> asm_texts, uint64_t first_addr, uint64_t first_stack_limit_addr, int max_param_stack_offset)
+		: first_addr{ first_addr }, last_addr{ first_addr + asm_texts.back().offset }, first_stack_limit_addr{ first_stack_limit_addr },
 		  max_param_stack_offset{ max_param_stack_offset }, asm_texts{ std::move(asm_texts) } {}
 
 	std::vector<AsmText>& Data() { return asm_texts; }
+	const std::vector<AsmText>& Data() const { return asm_texts; }
+
+	uint64_t Address(const AsmText& asm_text) const { return first_addr + asm_text.offset; }
 
 	size_t AtIndex(uint64_t addr) {
 		ASSERT(addr >= first_addr && addr <= last_addr);
 		// TODO: below is specific to arm64
 		// estimate index (normally 4 bytes per instruction for arm64)
 		auto idx = (addr - first_addr) / 4;
-		while (asm_texts[idx].addr < addr)
+		while (Address(asm_texts[idx]) < addr)
 			++idx;
 		return idx;
 	}
@@ -67,6 +75,8 @@ struct FnParamInfo {
 	DartType* type{ nullptr };
 	std::string name;
 	std::unique_ptr<VarValue> val;
+	// val is in the scratch arena of analysis. it is rendered to text when analysis is finished.
+	std::string valText;
 
 	explicit FnParamInfo() {}
 	explicit FnParamInfo(A64::Register paramReg, A64::Register valReg, int32_t localOffset) : paramReg(paramReg), valReg(valReg), localOffset(localOffset) {}
@@ -78,6 +88,8 @@ struct FnParamInfo {
 	explicit FnParamInfo(A64::Register valReg, std::string name) : valReg(valReg), name(std::move(name)) {}
 	explicit FnParamInfo(std::string name) : name(std::move(name)) {}
 
+	bool HasValue() const { return val || !valText.empty(); }
+	std::string ValueText() const { return val ? val->ToString() : valText; }
 	std::string ToString() const;
 };
 
@@ -169,6 +181,14 @@ public:
 		il_insns.pop_back();
 	}
 
+	// create the scratch arena for ILs and values of this function
+	Arena& BeginIL();
+	// render ILs into ils and parameter values into text, then release the scratch arena.
+	// call it when analysis of the function is finished. returns the released arena size.
+	size_t FinishIL();
+
+	// memory of ILs and values while analyzing. it must be destroyed last.
+	std::unique_ptr<Arena> scratch;
 	DartApp& app;
 	DartFunction& dartFn;
 	AsmTexts asmTexts;
@@ -177,7 +197,9 @@ public:
 	bool useFramePointer{ false };
 	uint64_t firstCheckStackOverflowAddr{ 0 };
 	FnParams params;
+	// ILs while analyzing. they are moved to ils by FinishIL()
 	std::vector<std::unique_ptr<ILInstr>> il_insns;
+	ILStream ils;
 	DartType* returnType{ nullptr };
 
 	//int firstParamOffset{ 0 };
@@ -202,18 +224,59 @@ private:
 	friend class CodeAnalyzer;
 };
 
+struct AsmMatcherStat {
+	const char* name;
+	uint64_t hits; // matcher returns IL
+	uint64_t rejects; // matcher returns nothing or throws an exception
+};
+
 class CodeAnalyzer
 {
 public:
-	CodeAnalyzer(DartApp& app) : app(app) {};
+	// numJobs is number of threads for analyzing functions. the result is same for any number of threads.
+	CodeAnalyzer(DartApp& app, unsigned numJobs = 1) : app(app), numJobs(numJobs) {};
 
+	// functions that are already analyzed are skipped
 	void AnalyzeAll();
+	// analyze one function on the calling thread (for queries)
+	void AnalyzeFunction(DartFunction& dartFn);
+	// for streaming mode. analyze only functions in a library, then release the result after using it
+	void AnalyzeLibrary(DartLibrary& lib);
+	static void ReleaseLibrary(DartLibrary& lib);
+	// functions that have valid cache record are not analyzed. new analysis results are added to the cache.
+	void SetCache(AnalysisCache* cache) { this->cache = cache; }
+	// only functions selected by the filter are analyzed
+	void SetFilter(const CodeFilter* filter) { this->filter = filter; }
+
+	uint64_t NumAnalyzedFunctions() const { return numFunctions; }
+	uint64_t NumInstructions() const { return numInstructions; }
+	uint64_t NumILs() const { return numILs; }
+	// scratch arena bytes released by FinishIL() and bytes of ILStream kept after it
+	uint64_t ILArenaBytes() const { return ilArenaBytes; }
+	uint64_t ILStreamBytes() const { return ilStreamBytes; }
+	// only candidate matchers of an instruction id are invoked. see matchers in CodeAnalyzer_arm64.cpp
+	std::vector<AsmMatcherStat> MatcherStats() const;
+
+	static constexpr size_t MaxMatchers = 32;
 
 private:
+	void analyzeFunction(Disassembler& disasmer, DartFunction* dartFn);
 	static AsmTexts convertAsm(AsmInstructions& asm_insns);
 	
 	// implementation is specific to architecture
 	void asm2il(DartFunction* dartFn, AsmInstructions& asm_insns);
 
 	DartApp& app;
+	unsigned numJobs;
+	AnalysisCache* cache{ nullptr };
+	const CodeFilter* filter{ nullptr };
+
+	// statistics. updated from analysis threads
+	std::atomic<uint64_t> numFunctions{ 0 };
+	std::atomic<uint64_t> numInstructions{ 0 };
+	std::atomic<uint64_t> numILs{ 0 };
+	std::atomic<uint64_t> ilArenaBytes{ 0 };
+	std::atomic<uint64_t> ilStreamBytes{ 0 };
+	std::array<std::atomic<uint64_t>, MaxMatchers> matcherHits{};
+	std::array<std::atomic<uint64_t>, MaxMatchers> matcherRejects{};
 };
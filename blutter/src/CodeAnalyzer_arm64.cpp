@@ -258,7 +258,12 @@ public:
 	FunctionAnalyzer(AnalyzedFnData* fnInfo, DartFunction* dartFn, AsmInstructions& asm_insns, DartApp& app)
 		: fnInfo{ fnInfo }, dartFn{ dartFn }, asm_insns{ asm_insns }, app{ app } {}
 
-	void asm2il();
+	// number of matcher results in a function. index is matcher index
+	struct MatcherCounts {
+		std::array<uint32_t, CodeAnalyzer::MaxMatchers> hits;
+		std::array<uint32_t, CodeAnalyzer::MaxMatchers> rejects;
+	};
+	void asm2il(MatcherCounts& counts);
 
 	// returns an instruction after the prologue
 	void handlePrologue(AsmIterator& insItr, uint64_t endPrologueAddr);
@@ -338,33 +343,59 @@ private:
 };
 
 typedef std::unique_ptr<ILInstr>(FunctionAnalyzer::* AsmMatcherFn)(AsmIterator& insn);
-static const AsmMatcherFn matcherFns[] = {
-	(AsmMatcherFn) &FunctionAnalyzer::processEnterFrameInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLeaveFrameInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processAllocateStackInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processCheckStackOverflowInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processCallLeafRuntime,
-	(AsmMatcherFn) &FunctionAnalyzer::processObjectPoolInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLoadValueNoObjectPoolInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processDecompressPointerInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processClosureCallInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processSaveRegisterInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLoadSavedRegisterInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processInitAsyncInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processCallInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processGdtCallInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processReturnInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processInstanceofNoTypeArgumentInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processBranchIfSmiInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLoadClassIdInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processBoxInt64Instr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLoadInt32FromBoxOrSmiInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processLoadTaggedClassIdMayBeSmiInstr,
-	&FunctionAnalyzer::processLoadFieldTableInstr,
-	(AsmMatcherFn) &FunctionAnalyzer::processTryAllocateObject,
-	(AsmMatcherFn) &FunctionAnalyzer::processWriteBarrierInstr,
-	&FunctionAnalyzer::processLoadStore,
+struct AsmMatcher {
+	AsmMatcherFn fn;
+	const char* name;
+	// instruction ids that can start the matcher pattern.
+	// the matcher always returns nullptr (without exception) when current instruction is not one of them.
+	std::vector<arm64_insn> firstInsnIds;
+};
+// the order is important. the first matcher that returns IL is used.
+static const AsmMatcher matchers[] = {
+	{ (AsmMatcherFn) &FunctionAnalyzer::processEnterFrameInstr, "EnterFrame", { ARM64_INS_STP } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLeaveFrameInstr, "LeaveFrame", { ARM64_INS_MOV } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processAllocateStackInstr, "AllocateStack", { ARM64_INS_SUB } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processCheckStackOverflowInstr, "CheckStackOverflow", { ARM64_INS_LDR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processCallLeafRuntime, "CallLeafRuntime", { ARM64_INS_AND, ARM64_INS_MOV, ARM64_INS_LDR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processObjectPoolInstr, "ObjectPool", { ARM64_INS_LDR, ARM64_INS_ADD, ARM64_INS_MOV, ARM64_INS_STR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLoadValueNoObjectPoolInstr, "LoadValueNoObjectPool",
+		{ ARM64_INS_MOVZ, ARM64_INS_MOV, ARM64_INS_ORR, ARM64_INS_MOVN, ARM64_INS_EOR, ARM64_INS_FMOV } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processDecompressPointerInstr, "DecompressPointer", { ARM64_INS_ADD } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processClosureCallInstr, "ClosureCall", { ARM64_INS_LDUR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processSaveRegisterInstr, "SaveRegister", { ARM64_INS_STR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLoadSavedRegisterInstr, "LoadSavedRegister", { ARM64_INS_LDR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processInitAsyncInstr, "InitAsync", { ARM64_INS_BL } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processCallInstr, "Call", { ARM64_INS_BL, ARM64_INS_B } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processGdtCallInstr, "GdtCall", { ARM64_INS_ADD, ARM64_INS_SUB } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processReturnInstr, "Return", { ARM64_INS_RET } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processInstanceofNoTypeArgumentInstr, "InstanceofNoTypeArgument", { ARM64_INS_MOV } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processBranchIfSmiInstr, "BranchIfSmi", { ARM64_INS_TBZ } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLoadClassIdInstr, "LoadClassId", { ARM64_INS_LDUR, ARM64_INS_LDURH } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processBoxInt64Instr, "BoxInt64", { ARM64_INS_SBFIZ } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLoadInt32FromBoxOrSmiInstr, "LoadInt32FromBoxOrSmi", { ARM64_INS_SBFX } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processLoadTaggedClassIdMayBeSmiInstr, "LoadTaggedClassIdMayBeSmi", { ARM64_INS_LSL } },
+	{ &FunctionAnalyzer::processLoadFieldTableInstr, "LoadFieldTable", { ARM64_INS_LDR } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processTryAllocateObject, "TryAllocateObject", { ARM64_INS_LDP } },
+	{ (AsmMatcherFn) &FunctionAnalyzer::processWriteBarrierInstr, "WriteBarrier", { ARM64_INS_TBZ, ARM64_INS_LDURB } },
+	// first instruction ids of processLoadStore() are ADD and the load/store ids in getArrayOp()
+	{ &FunctionAnalyzer::processLoadStore, "LoadStore", { ARM64_INS_ADD, ARM64_INS_LDUR, ARM64_INS_LDURSW, ARM64_INS_LDRB, ARM64_INS_LDRSB,
+		ARM64_INS_LDRH, ARM64_INS_LDURSH, ARM64_INS_STUR, ARM64_INS_STRB, ARM64_INS_STURH } },
 };
+static_assert(std::size(matchers) <= CodeAnalyzer::MaxMatchers);
+
+// candidate matcher indices for each instruction id. the indices are in matchers order.
+static const std::vector<uint8_t>& getCandidateMatchers(unsigned int insnId)
+{
+	static const auto candidates = [] {
+		std::vector<std::vector<uint8_t>> candidates(ARM64_INS_ENDING);
+		for (uint8_t i = 0; i < std::size(matchers); i++) {
+			for (auto id : matchers[i].firstInsnIds)
+				candidates[id].push_back(i);
+		}
+		return candidates;
+	}();
+	return candidates[insnId];
+}
 
 FunctionAnalyzer::ObjectPoolInstr FunctionAnalyzer::getObjectPoolInstruction(AsmIterator& insn)
 {
@@ -3603,7 +3634,7 @@ std::unique_ptr<ILInstr> FunctionAnalyzer::processLoadStore(AsmIterator& insn)
 	return nullptr;
 }
 
-void FunctionAnalyzer::asm2il()
+void FunctionAnalyzer::asm2il(MatcherCounts& counts)
 {
 	AsmIterator insn(asm_insns.FirstPtr(), asm_insns.LastPtr());
 
@@ -3611,17 +3642,22 @@ void FunctionAnalyzer::asm2il()
 
 	do {
 		bool ok = false;
+		uint8_t matcherIdx = 0;
 		try {
-			for (auto matcher : matcherFns) {
-				auto il = std::invoke(matcher, this, insn);
+			for (auto idx : getCandidateMatchers(insn.id())) {
+				matcherIdx = idx;
+				auto il = std::invoke(matchers[idx].fn, this, insn);
 				if (il) {
 					fnInfo->AddIL(std::move(il));
 					ok = true;
+					counts.hits[idx]++;
 					break;
 				}
+				counts.rejects[idx]++;
 			}
 		}
 		catch (InsnException& e) {
+			counts.rejects[matcherIdx]++;
 			printInsnException(e);
 		}
 
@@ -3637,109 +3673,67 @@ void FunctionAnalyzer::asm2il()
 void CodeAnalyzer::asm2il(DartFunction* dartFn, AsmInstructions& asm_insns)
 {
 	FunctionAnalyzer analyzer{ dartFn->GetAnalyzedData(), dartFn, asm_insns, app };
-	analyzer.asm2il();
+	FunctionAnalyzer::MatcherCounts counts{};
+	analyzer.asm2il(counts);
+
+	for (size_t i = 0; i < std::size(matchers); i++) {
+		if (counts.hits[i])
+			matcherHits[i] += counts.hits[i];
+		if (counts.rejects[i])
+			matcherRejects[i] += counts.rejects[i];
+	}
+}
+
+std::vector<AsmMatcherStat> CodeAnalyzer::MatcherStats() const
+{
+	std::vector<AsmMatcherStat> stats;
+	for (size_t i = 0; i < std::size(matchers); i++) {
+		stats.push_back(AsmMatcherStat{ matchers[i].name, matcherHits[i], matcherRejects[i] });
+	}
+	return stats;
 }
 	
 AsmTexts CodeAnalyzer::convertAsm(AsmInstructions& asm_insns)
 {
-	// convert register name in op_str
 	std::vector<AsmText> asm_texts(asm_insns.Count());
+	const uint64_t first_addr = asm_insns.FirstPtr()->address;
 	uint64_t first_stack_limit_addr = 0;
 	int max_param_stack_offset = 0;
 
 	for (size_t i = 0; i < asm_insns.Count(); i++) {
 		auto insn = asm_insns.Ptr(i);
 		auto& text_asm = asm_texts.at(i);
+		const auto& detail = insn->detail->arm64;
 
-		text_asm.addr = insn->address;
+		text_asm.offset = (uint32_t)(insn->address - first_addr);
 		text_asm.dataType = AsmText::None;
-		
-		memset(text_asm.text, ' ', 16);
-		memcpy(text_asm.text, insn->mnemonic, strlen(insn->mnemonic));
-		auto ptr = text_asm.text + 16;
-		auto op_ptr = insn->op_str;
-		bool token_start = true;
-		while (*op_ptr != '\0') {
-			if (token_start) { 
-				if (op_ptr[0] == 'x' || op_ptr[0] == 'w') {
-					bool do_replacement = true;
-					if (op_ptr[1] == '1' && op_ptr[2] == '5') {
-						*ptr++ = 'S';
-						*ptr++ = 'P';
-					}
-					else if (op_ptr[1] == '2' && op_ptr[2] == '2') {
-						*ptr++ = 'N';
-						*ptr++ = 'U';
-						*ptr++ = 'L';
-						*ptr++ = 'L';
-					}
-					else if (op_ptr[1] == '2' && op_ptr[2] == '6') {
-						*ptr++ = 'T';
-						*ptr++ = 'H';
-						*ptr++ = 'R';
-						// Normally thread access is part of instructions. we don't need this case for translating to IL.
-						// but the thread offset information is nice to have in assembly
-						// thread access always be the last operand
-						auto& op = insn->detail->arm64.operands[insn->detail->arm64.op_count - 1];
-						if (op.type == ARM64_OP_MEM && op.mem.base == CSREG_DART_THR) {
-							text_asm.threadOffset = op.mem.disp;
-							text_asm.dataType = AsmText::ThreadOffset;
-							if (first_stack_limit_addr == 0 && op.mem.disp == AOT_Thread_stack_limit_offset) {
-								// mark it as end of prologue
-								first_stack_limit_addr = insn->address;
-							}
-						}
-					}
-					else if (op_ptr[1] == '2' && op_ptr[2] == '7') {
-						*ptr++ = 'P';
-						*ptr++ = 'P';
-					}
-					else if (op_ptr[1] == '2' && op_ptr[2] == '8') {
-						*ptr++ = 'H';
-						*ptr++ = 'E';
-						*ptr++ = 'A';
-						*ptr++ = 'P';
-					}
-					else if (op_ptr[1] == '2' && op_ptr[2] == '9') {
-						*ptr++ = 'f';
-						*ptr++ = 'p';
-						// save maximum stack offset for accessing parameter
-						if (insn->id == ARM64_INS_LDR) {
-							auto& op = insn->detail->arm64.operands[1];
-							if (op.mem.base == CSREG_DART_FP && op.mem.disp > max_param_stack_offset) {
-								max_param_stack_offset = op.mem.disp;
-							}
-						}
-					}
-					else if (op_ptr[1] == '3' && op_ptr[2] == '0') {
-						*ptr++ = 'l';
-						*ptr++ = 'r';
-					}
-					else {
-						do_replacement = false;
-					}
 
-					if (do_replacement) {
-						op_ptr += 3;
-						continue;
-					}
-				}
+		if (detail.op_count == 0)
+			continue;
+
+		// Normally thread access is part of instructions. we don't need this case for translating to IL.
+		// but the thread offset information is nice to have in assembly
+		// thread access always be the last operand
+		auto& last_op = detail.operands[detail.op_count - 1];
+		if (last_op.type == ARM64_OP_MEM && last_op.mem.base == CSREG_DART_THR) {
+			text_asm.threadOffset = last_op.mem.disp;
+			text_asm.dataType = AsmText::ThreadOffset;
+			if (first_stack_limit_addr == 0 && last_op.mem.disp == AOT_Thread_stack_limit_offset) {
+				// mark it as end of prologue
+				first_stack_limit_addr = insn->address;
 			}
-			switch (*op_ptr) {
-			case ' ':
-			case '[':
-				token_start = true;
-				break;
-			default:
-				token_start = false;
-				break;
+		}
+
+		// save maximum stack offset for accessing parameter
+		if (insn->id == ARM64_INS_LDR && detail.op_count > 1) {
+			auto& op = detail.operands[1];
+			if (op.type == ARM64_OP_MEM && op.mem.base == CSREG_DART_FP && op.mem.disp > max_param_stack_offset) {
+				max_param_stack_offset = op.mem.disp;
 			}
-			*ptr++ = *op_ptr++;
 		}
-		*ptr = '\0';
 	}
 
-	return AsmTexts{ asm_texts, first_stack_limit_addr, max_param_stack_offset };
+	return AsmTexts{ std::move(asm_texts), first_addr, first_stack_limit_addr, max_param_stack_offset };
 }
 
 #endif // NO_CODE_ANALYSIS
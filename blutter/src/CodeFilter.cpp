@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "CodeFilter.h"
+#include "DartClass.h"
+#include "DartFunction.h"
+#include "DartLibrary.h"
+
+void CodeFilter::addRule(const std::string& rule, bool exclude)
+{
+	const auto sep = rule.find('=');
+	if (sep == std::string::npos)
+		throw std::runtime_error(std::format("invalid filter rule '{}'. expect KIND=PATTERN", rule));
+
+	const auto kindName = rule.substr(0, sep);
+	Kind kind;
+	if (kindName == "lib")
+		kind = Library;
+	else if (kindName == "class")
+		kind = Class;
+	else if (kindName == "fn")
+		kind = Function;
+	else
+		throw std::runtime_error(std::format("invalid filter kind '{}'. expect lib, class or fn", kindName));
+
+	auto pattern = rule.substr(sep + 1);
+	Rule r{ .kind = kind, .exclude = exclude, .isRegex = false };
+	if (pattern.size() >= 2 && pattern.front() == '/' && pattern.back() == '/') {
+		r.isRegex = true;
+		try {
+			r.re = std::regex(pattern.substr(1, pattern.size() - 2), std::regex::ECMAScript | std::regex::optimize);
+		}
+		catch (std::regex_error& e) {
+			throw std::runtime_error(std::format("invalid filter regex '{}': {}", pattern, e.what()));
+		}
+	}
+	else {
+		r.glob = std::move(pattern);
+	}
+	rules.push_back(std::move(r));
+	if (!exclude)
+		hasInclude[kind] = true;
+}
+
+void CodeFilter::AddAddressRange(const std::string& range)
+{
+	const auto sep = range.find('-');
+	if (sep == std::string::npos)
+		throw std::runtime_error(std::format("invalid address range '{}'. expect START-END", range));
+	try {
+		const auto start = std::stoull(range.substr(0, sep), nullptr, 16);
+		const auto end = std::stoull(range.substr(sep + 1), nullptr, 16);
+		if (start >= end)
+			throw std::runtime_error("");
+		addrRanges.emplace_back(start, end);
+	}
+	catch (std::exception&) {
+		throw std::runtime_error(std::format("invalid address range '{}'. expect START-END", range));
+	}
+}
+
+bool CodeFilter::Rule::Match(const std::string& name) const
+{
+	if (isRegex)
+		return std::regex_match(name, re);
+	return matchGlob(glob.c_str(), name.c_str());
+}
+
+bool CodeFilter::matchKind(Kind kind, const std::string& name) const
+{
+	bool included = !hasInclude[kind];
+	for (const auto& rule : rules) {
+		if (rule.kind != kind)
+			continue;
+		if (rule.exclude) {
+			if (rule.Match(name))
+				return false;
+		}
+		else if (!included) {
+			included = rule.Match(name);
+		}
+	}
+	return included;
+}
+
+bool CodeFilter::MatchLibrary(const DartLibrary& lib) const
+{
+	return matchKind(Library, lib.url);
+}
+
+bool CodeFilter::MatchClass(const DartClass& cls) const
+{
+	return MatchLibrary(cls.Library()) && matchKind(Class, cls.Name());
+}
+
+bool CodeFilter::MatchFunction(const DartFunction& dartFn) const
+{
+	if (!addrRanges.empty()) {
+		const auto addr = dartFn.Address();
+		const auto inRange = std::any_of(addrRanges.begin(), addrRanges.end(), [addr](const auto& range) {
+			return addr >= range.first && addr < range.second;
+		});
+		if (!inRange)
+			return false;
+	}
+	return MatchClass(dartFn.Class()) && matchKind(Function, dartFn.Name());
+}
+
+bool CodeFilter::matchGlob(const char* pattern, const char* name)
+{
+	// iterative wildcard matching. backtrack only to the last '*'.
+	const char* starPattern = nullptr;
+	const char* starName = nullptr;
+	while (*name) {
+		if (*pattern == '*') {
+			starPattern = ++pattern;
+			starName = name;
+		}
+		else if (*pattern == '?' || *pattern == *name) {
+			pattern++;
+			name++;
+		}
+		else if (starPattern) {
+			pattern = starPattern;
+			name = ++starName;
+		}
+		else {
+			return false;
+		}
+	}
+	while (*pattern == '*')
+		pattern++;
+	return *pattern == '\0';
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <regex>
+
+class DartClass;
+class DartFunction;
+class DartLibrary;
+
+// Selection of code for analysis and dumping. A rule is "KIND=PATTERN" where KIND is "lib" (library url), "class" or "fn"
+// (function name). PATTERN is a glob ('*' and '?') or a regex when it is enclosed with '/'. a pattern must match a whole name.
+// Code is selected when
+//   - it matches at least one include rule of each kind that has include rules
+//   - it matches no exclude rule
+//   - the function entry point is in one of the address ranges (if any)
+// An empty filter selects everything.
+class CodeFilter
+{
+public:
+	CodeFilter() = default;
+	CodeFilter(const CodeFilter&) = delete;
+	CodeFilter(CodeFilter&&) = delete;
+	CodeFilter& operator=(const CodeFilter&) = delete;
+
+	void AddInclude(const std::string& rule) { addRule(rule, false); }
+	void AddExclude(const std::string& rule) { addRule(rule, true); }
+	// range is "START-END" (END is exclusive). addresses are offsets from the libapp base in hex.
+	void AddAddressRange(const std::string& range);
+
+	bool Empty() const { return rules.empty() && addrRanges.empty(); }
+	// true when only some functions are selected by include function rules or address ranges.
+	// then a library or class without a selected function is not needed.
+	bool HasFunctionSelection() const { return hasInclude[Function] || !addrRanges.empty(); }
+
+	// library and class checks only use rules of their levels. they are used for skipping whole library or class.
+	bool MatchLibrary(const DartLibrary& lib) const;
+	bool MatchClass(const DartClass& cls) const;
+	bool MatchFunction(const DartFunction& dartFn) const;
+
+private:
+	enum Kind : uint8_t {
+		Library,
+		Class,
+		Function,
+	};
+
+	struct Rule {
+		Kind kind;
+		bool exclude;
+		bool isRegex;
+		std::string glob;
+		std::regex re;
+
+		bool Match(const std::string& name) const;
+	};
+
+	void addRule(const std::string& rule, bool exclude);
+	bool matchKind(Kind kind, const std::string& name) const;
+
+	static bool matchGlob(const char* pattern, const char* name);
+
+	std::vector<Rule> rules;
+	std::vector<std::pair<uint64_t, uint64_t>> addrRanges;
+	bool hasInclude[3]{};
+};
@@ -6,8 +6,10 @@ PRAGMA_WARNING(push, 0)
 #include <vm/stub_code.h>
 #include <vm/heap/safepoint.h>
 PRAGMA_WARNING(pop)
+#include <bit>
 #include <format>
 #include <iostream> // for debugging purpose
+#include <unordered_set>
 
 DartApp::DartApp(const char* path) : ppool(NULL), nativeLib(0xdeadead), throwStubAddr(0)
 {
@@ -18,7 +20,16 @@ DartApp::DartApp(const char* path) : ppool(NULL), nativeLib(0xdeadead), throwStu
 	isolate_snapshot_data = libInfo.isolate_snapshot_data;
 	isolate_snapshot_instructions = libInfo.isolate_snapshot_instructions;
 
-	isolate = reinterpret_cast<dart::Isolate*>(DartLoader::Load(libInfo));
+	lib_size = libInfo.size;
+
+	try {
+		isolate = reinterpret_cast<dart::Isolate*>(DartLoader::Load(libInfo));
+	}
+	catch (...) {
+		// the destructor is not called
+		DartLoader::Unload(libInfo);
+		throw;
+	}
 
 	heap_base_ = dart::Thread::Current()->heap_base();
 	inScope = false;
@@ -40,7 +51,14 @@ DartApp::DartApp(const char* path) : ppool(NULL), nativeLib(0xdeadead), throwStu
 DartApp::~DartApp()
 {
 	ExitScope();
-	DartLoader::Unload();
+	DartLoader::Unload(LibAppInfo{
+		.lib = lib_base,
+		.vm_snapshot_data = vm_snapshot_data,
+		.vm_snapshot_instructions = vm_snapshot_instructions,
+		.isolate_snapshot_data = isolate_snapshot_data,
+		.isolate_snapshot_instructions = isolate_snapshot_instructions,
+		.size = lib_size,
+	});
 
 	for (auto lib : libs) {
 		delete lib;
@@ -50,6 +68,15 @@ DartApp::~DartApp()
 	for (auto& stub : stubs) {
 		delete stub.second;
 	}
+	for (auto& stub : splitStubs) {
+		delete stub.second;
+	}
+}
+
+std::string DartApp::SnapshotHash() const
+{
+	// header is magic (4 bytes), length (8 bytes) and kind (8 bytes). the hash is 32 characters.
+	return std::string((const char*)vm_snapshot_data + 20, 32);
 }
 
 void DartApp::EnterScope()
@@ -75,6 +102,54 @@ void DartApp::ExitScope()
 	}
 }
 
+std::string DartApp::PoolObjectDigest(uint64_t offset)
+{
+	auto& pool = *ppool;
+	const auto idx = dart::ObjectPool::IndexFromOffset(offset);
+	if (idx < 0 || idx >= pool.Length())
+		return "";
+	const auto entryType = pool.TypeAt(idx);
+	if (entryType != dart::ObjectPool::EntryType::kTaggedObject) {
+		// native function address is in this process
+		if (entryType != dart::ObjectPool::EntryType::kImmediate)
+			return std::format("entry {}", (int)entryType);
+		// an immediate in the app is an entry point (e.g. stub of UnlinkedCall). its address depends on load address and build.
+		const auto val = pool.RawValueAt(idx);
+		if (val >= (uintptr_t)base() && val < (uintptr_t)base() + lib_size) {
+			auto fn = FindFunction(val - base());
+			return std::format("imm {}", fn ? fn->FullName() : "app");
+		}
+		return std::format("imm {:#x}", val);
+	}
+
+	// class id of app classes might be changed in next build. the class name is in ToCString() result.
+	auto stableCid = [](intptr_t cid) { return cid < dart::kNumPredefinedCids ? cid : -1; };
+	auto zone = dart::Thread::Current()->zone();
+	const auto& obj = dart::Object::Handle(zone, pool.ObjectAt(idx));
+	auto digest = std::format("{} {}", stableCid(obj.GetClassId()), obj.ToCString());
+	switch (obj.GetClassId()) {
+	case dart::kArrayCid:
+	case dart::kImmutableArrayCid: {
+		// ToCString() does not show the elements. the content of arguments descriptor is used in IL.
+		const auto& arr = dart::Array::Cast(obj);
+		auto& elem = dart::Object::Handle(zone);
+		for (intptr_t i = 0; i < arr.Length() && i < 64; i++) {
+			elem = arr.At(i);
+			digest += elem.IsSmi() ? std::format(",{}", dart::Smi::Cast(elem).Value()) : std::format(",c{}", stableCid(elem.GetClassId()));
+		}
+		break;
+	}
+	case dart::kUnlinkedCallCid:
+		if (idx + 1 < pool.Length()) {
+			auto stub = FindFunction(pool.RawValueAt(idx + 1) - base());
+			if (stub)
+				digest += stub->FullName();
+		}
+		break;
+	}
+	return digest;
+}
+
 DartClass* DartApp::GetClass(intptr_t cid)
 {
 	if ((size_t)cid > classes.size()) {
@@ -84,26 +159,121 @@ DartClass* DartApp::GetClass(intptr_t cid)
 	return classes.at(cid);
 }
 
+void DartApp::ReleaseAnalyzedData()
+{
+	for (auto& [addr, dartFn] : functions) {
+		dartFn->ReleaseAnalyzedData();
+	}
+}
+
 DartFnBase* DartApp::GetFunction(uint64_t addr)
 {
 	auto fn = functions.find(addr);
 	if (fn != functions.end()) {
 		return fn->second;
 	}
-
 	auto stub = stubs.find(addr);
 	if (stub != stubs.end()) {
 		return stub->second;
 	}
+
 	// another possible is duplicated stubs in one big stub
-	for (auto& [ep_addr, stub] : stubs) {
-		if (stub->Address() < addr && addr < stub->AddressEnd()) {
-			auto newStub = stub->Split(addr);
-			stubs[addr] = newStub;
-			return newStub;
+	auto entry = addressIndex.Find(addr);
+	if (entry == nullptr || !entry->fn->IsStub())
+		return nullptr;
+	return splitStub(*entry, addr);
+}
+
+DartFnBase* DartApp::FindFunction(uint64_t addr)
+{
+	auto entry = addressIndex.Find(addr);
+	if (entry == nullptr)
+		return nullptr;
+	if (!entry->fn->IsStub())
+		return entry->fn;
+
+	// the stub might be split before. find the piece that contains the address.
+	std::lock_guard lock(stubsMutex);
+	auto itr = splitStubs.upper_bound(addr);
+	if (itr != splitStubs.begin()) {
+		--itr;
+		if (itr->first >= entry->addr && itr->second->ContainsAddress(addr))
+			return itr->second;
+	}
+	return entry->fn;
+}
+
+void DartApp::GetFunctions(std::span<const uint64_t> addrs, std::span<DartFnBase*> results)
+{
+	ASSERT(addrs.size() == results.size());
+	std::vector<uint64_t> missAddrs;
+	std::vector<size_t> missIdxs;
+	for (size_t i = 0; i < addrs.size(); i++) {
+		auto fn = functions.find(addrs[i]);
+		if (fn != functions.end()) {
+			results[i] = fn->second;
+			continue;
+		}
+		auto stub = stubs.find(addrs[i]);
+		if (stub != stubs.end()) {
+			results[i] = stub->second;
+			continue;
 		}
+		missAddrs.push_back(addrs[i]);
+		missIdxs.push_back(i);
+	}
+	if (missAddrs.empty())
+		return;
+
+	std::vector<const FnAddressIndex::Entry*> entries(missAddrs.size());
+	addressIndex.Find(missAddrs, entries);
+	for (size_t i = 0; i < missAddrs.size(); i++) {
+		auto entry = entries[i];
+		results[missIdxs[i]] = (entry && entry->fn->IsStub()) ? splitStub(*entry, missAddrs[i]) : nullptr;
 	}
-	return nullptr;
+}
+
+DartStub* DartApp::splitStub(const FnAddressIndex::Entry& entry, uint64_t addr)
+{
+	// stubs might be split while other threads are looking up
+	std::lock_guard lock(stubsMutex);
+	// the stub might be split before. find the piece that contains the address.
+	auto piece = entry.fn->AsStub();
+	auto itr = splitStubs.upper_bound(addr);
+	if (itr != splitStubs.begin()) {
+		--itr;
+		if (itr->first >= entry.addr)
+			piece = itr->second;
+	}
+	if (piece->Address() == addr)
+		return piece;
+	auto newStub = piece->Split(addr);
+	splitStubs[addr] = newStub;
+	return newStub;
+}
+
+std::vector<DartStub*> DartApp::Stubs()
+{
+	std::lock_guard lock(stubsMutex);
+	std::vector<DartStub*> result;
+	result.reserve(stubs.size() + splitStubs.size());
+	for (auto& [_, stub] : stubs)
+		result.push_back(stub);
+	for (auto& [_, stub] : splitStubs)
+		result.push_back(stub);
+	std::sort(result.begin(), result.end(), [](DartStub* a, DartStub* b) { return a->Address() < b->Address(); });
+	return result;
+}
+
+void DartApp::buildAddressIndex()
+{
+	std::vector<FnAddressIndex::Entry> entries;
+	entries.reserve(functions.size() + stubs.size());
+	for (auto& [addr, dartFn] : functions)
+		entries.push_back(FnAddressIndex::Entry{ addr, dartFn->AddressEnd(), dartFn });
+	for (auto& [addr, stub] : stubs)
+		entries.push_back(FnAddressIndex::Entry{ addr, stub->AddressEnd(), stub });
+	addressIndex = FnAddressIndex{ std::move(entries) };
 }
 
 DartLibrary* DartApp::addLibraryClass(const dart::Library& library, const dart::Class& cls)
@@ -170,6 +340,8 @@ void DartApp::LoadInfo()
 
 	finalizeFunctionsInfo();
 
+	buildAddressIndex();
+
 	//auto fieldTable = isolate->field_table(); //contains only sentinel, null, false, 0
 
 	// there are instruction tables in vm isolate but their code are not called from Dart code (can be skipped)
@@ -321,9 +493,14 @@ void DartApp::loadStubs(dart::ObjectStore* store)
 	// load VM stub code
 	// the dart entry point "static void main()" is a LazyCompileVMStub which call "main" stub (a real main)
 	ASSERT(dart::StubCode::HasBeenInitialized());
+	// dart::StubCode is loaded from VM snapshot of the first app (--batch) that is mapped at another address.
+	// the stub offset in VM snapshot instructions is rebased onto this app's VM snapshot instructions.
+	const auto vmStubBase = (intptr_t)DartLoader::VMSnapshotInstructions();
+	const auto vmInstrOffset = (intptr_t)vm_snapshot_instructions - base();
 #define DO(name) {\
 		const auto& code = dart::StubCode::name(); \
-		ep_addr = code.EntryPoint() - base(); \
+		ep_addr = code.EntryPoint() - vmStubBase + vmInstrOffset; \
+		checkVMStub(code, ep_addr, #name); \
 		if (stubs.contains(ep_addr)) { \
 			ASSERT(stubs[ep_addr]->Name() == #name); \
 		} \
@@ -342,6 +519,17 @@ void DartApp::loadStubs(dart::ObjectStore* store)
 #undef DO
 }
 
+void DartApp::checkVMStub(const dart::Code& code, uint64_t ep_addr, const char* name)
+{
+	// same VM snapshot hash should mean same VM stubs. make sure a batch run gives the same result as a single run.
+	if ((intptr_t)vm_snapshot_instructions == (intptr_t)DartLoader::VMSnapshotInstructions())
+		return;
+	const auto payloadAddr = (intptr_t)ep_addr + ((intptr_t)code.PayloadStart() - (intptr_t)code.EntryPoint());
+	if (payloadAddr < 0 || (size_t)(payloadAddr + code.Size()) > lib_size ||
+		memcmp((const void*)(base() + payloadAddr), (const void*)code.PayloadStart(), code.Size()) != 0)
+		throw std::runtime_error(std::format("VM stub {} is different from the first loaded app", name));
+}
+
 DartFunction* DartApp::addFunctionNoCheck(const dart::Function& func)
 {
 	// find its class or library, then add it
@@ -391,6 +579,85 @@ private:
 	std::vector<dart::CodePtr>& codePtrs;
 };
 
+// Finds a known stub for a stub code that is not in object store (a copy of a known stub).
+// Stubs are indexed by size and code hash, so most lookups are an exact match of one bucket.
+// When no stub has the same code, the stub of same size with most same bytes is used.
+class StubMatcher {
+public:
+	void Add(DartStub* stub) {
+		const auto size = (size_t)stub->Size();
+		byHash.emplace(hashCode((const uint8_t*)stub->MemAddress(), size), stub);
+		bySize[size].push_back(stub);
+	}
+
+	DartStub* Find(const uint8_t* code, size_t size) const {
+		auto [first, last] = byHash.equal_range(hashCode(code, size));
+		DartStub* found = nullptr;
+		for (auto itr = first; itr != last; ++itr) {
+			auto stub = itr->second;
+			// prefer the stub at lowest address for same result in every run
+			if ((size_t)stub->Size() == size && memcmp((void*)stub->MemAddress(), code, size) == 0 && (!found || stub->Address() < found->Address()))
+				found = stub;
+		}
+		if (found)
+			return found;
+
+		auto candidates = bySize.find(size);
+		if (candidates == bySize.end())
+			return nullptr;
+		if (candidates->second.size() == 1)
+			return candidates->second[0];
+		size_t maxMatch = 0;
+		for (auto stub : candidates->second) {
+			const auto cnt = countSameBytes((const uint8_t*)stub->MemAddress(), code, size);
+			if (cnt > maxMatch) {
+				found = stub;
+				maxMatch = cnt;
+			}
+		}
+		return found;
+	}
+
+private:
+	static uint64_t hashCode(const uint8_t* code, size_t size) {
+		uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t val;
+			memcpy(&val, code + i, 8);
+			hash = (hash ^ val) * 0x100000001b3ULL;
+			hash ^= hash >> 29;
+		}
+		for (; i < size; i++)
+			hash = (hash ^ code[i]) * 0x100000001b3ULL;
+		return hash;
+	}
+
+	static size_t countSameBytes(const uint8_t* a, const uint8_t* b, size_t size) {
+		// compare 8 bytes at once. a byte of (x ^ y) is zero when the bytes are same.
+		constexpr uint64_t lowBits = 0x7f7f7f7f7f7f7f7fULL;
+		size_t cnt = 0;
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t x, y;
+			memcpy(&x, a + i, 8);
+			memcpy(&y, b + i, 8);
+			const auto diff = x ^ y;
+			// high bit of each byte is set only for zero byte
+			const auto zeroBytes = ~(((diff & lowBits) + lowBits) | diff | lowBits);
+			cnt += std::popcount(zeroBytes);
+		}
+		for (; i < size; i++) {
+			if (a[i] == b[i])
+				cnt++;
+		}
+		return cnt;
+	}
+
+	std::unordered_multimap<uint64_t, DartStub*> byHash;
+	std::unordered_map<size_t, std::vector<DartStub*>> bySize; // in added order
+};
+
 void DartApp::findFunctionInHeap()
 {
 	std::vector<dart::CodePtr> codePtrs;
@@ -401,6 +668,7 @@ void DartApp::findFunctionInHeap()
 	auto zone = dart::Thread::Current()->zone();
 	auto& code = dart::Code::Handle(zone);
 	auto& obj = dart::Object::Handle(zone);
+	std::unique_ptr<StubMatcher> stubMatcher;
 
 	for (dart::CodePtr code_ptr : codePtrs) {
 		code = code_ptr;
@@ -413,42 +681,26 @@ void DartApp::findFunctionInHeap()
 			if (!stubs.contains(ep_offset)) {
 				//std::cout << std::format("unknown stub at: {:#x}, {}, size: {}\n", ep_offset, code.ToCString(), code.Size());
 				auto stub_size = code.Size();
-				DartStub* candidateStub = nullptr;
-				std::vector<DartStub*> candidateStubs;
-				for (auto const& [stubEp, stub] : stubs) {
-					if (stub->kind < DartStub::SharedStub && stub->Size() == (int64_t)stub_size) {
-						if (memcmp((void*)stub->MemAddress(), (void*)entry_point, stub_size) == 0) {
-							// exact match
-							candidateStub = stub;
-							break;
-						}
-						candidateStubs.push_back(stub);
-					}
-				}
-				if (candidateStub == nullptr) {
-					RELEASE_ASSERT(!candidateStubs.empty());
-					if (candidateStubs.size() == 1) {
-						candidateStub = candidateStubs[0];
-					}
-					else {
-						uint32_t maxMatch = 0;
-						for (auto stub : candidateStubs) {
-							auto tmpCode = (uint8_t*)stub->MemAddress();
-							uint32_t cnt = 0;
-							for (size_t i = 0; i < stub_size; i++) {
-								if (((uint8_t*)entry_point)[i] == tmpCode[i])
-									cnt++;
-							}
-							if (cnt > maxMatch) {
-								candidateStub = stub;
-								maxMatch = cnt;
-							}
-						}
+				if (!stubMatcher) {
+					// most apps have no unknown stub. index known stubs only when needed.
+					stubMatcher = std::make_unique<StubMatcher>();
+					std::vector<DartStub*> knownStubs;
+					for (auto const& [stubEp, stub] : stubs) {
+						if (stub->kind < DartStub::SharedStub)
+							knownStubs.push_back(stub);
 					}
+					std::sort(knownStubs.begin(), knownStubs.end(), [](auto a, auto b) { return a->Address() < b->Address(); });
+					for (auto stub : knownStubs)
+						stubMatcher->Add(stub);
 				}
+				auto candidateStub = stubMatcher->Find((const uint8_t*)entry_point, stub_size);
+				RELEASE_ASSERT(candidateStub != nullptr);
 				//std::cout << std::format("unknown stub at: {:#x}, map to {}\n", ep_offset, candidateStub->Name());
 				ASSERT(candidateStub);
-				stubs[ep_offset] = new DartStub(code_ptr, candidateStub->kind, ep_offset, stub_size, candidateStub->Name());
+				auto newStub = new DartStub(code_ptr, candidateStub->kind, ep_offset, stub_size, candidateStub->Name());
+				stubs[ep_offset] = newStub;
+				// next unknown stub might be a copy of this one
+				stubMatcher->Add(newStub);
 			}
 			continue;
 		}
@@ -600,6 +852,8 @@ void DartApp::finalizeFunctionsInfo()
 			const intptr_t num_opt_pos_params = sig.NumOptionalPositionalParameters();
 			const intptr_t num_opt_named_params = sig.NumOptionalNamedParameters();
 			const intptr_t num_opt_params = num_opt_pos_params + num_opt_named_params;
+			dartFn->Signature().numOptionalParam = (int)num_opt_params;
+			dartFn->Signature().hasNamedParam = num_opt_named_params > 0;
 
 			auto& dname = dart::String::Handle();
 			for (intptr_t i = 0; i < num_params; i++) {
@@ -620,134 +874,177 @@ void DartApp::finalizeFunctionsInfo()
 	}
 }
 
-void DartApp::walkObject(dart::Object& obj)
+// Objects reachable from Object Pool are walked with an explicit worklist (a deep object graph cannot overflow the stack).
+// Every object is walked only once even if it is reachable from many pool entries.
+struct ObjectWalkState {
+	ObjectWalkState(uintptr_t heapBase, dart::Zone* zone)
+		: heapBase(heapBase), obj(dart::Object::Handle(zone)), fieldObj(dart::Object::Handle(zone)), func(dart::Function::Handle(zone)) {}
+	ObjectWalkState(const ObjectWalkState&) = delete;
+	ObjectWalkState(ObjectWalkState&&) = delete;
+	ObjectWalkState& operator=(const ObjectWalkState&) = delete;
+
+	// returns false if the object is already marked
+	bool Mark(dart::ObjectPtr ptr) {
+		const auto addr = dart::UntaggedObject::ToAddr(ptr);
+		// heap base is 0 without compressed pointers. objects can be anywhere in the address space then.
+		if (heapBase == 0 || addr < heapBase || addr - heapBase >= MaxBitmapRange)
+			return visitedOutside.insert(addr).second;
+		const auto idx = (addr - heapBase) / dart::kObjectAlignment;
+		const auto wordIdx = idx / 64;
+		if (wordIdx >= visited.size())
+			visited.resize(std::max<size_t>(wordIdx + 1, visited.size() * 2));
+		const auto mask = 1ULL << (idx % 64);
+		if (visited[wordIdx] & mask)
+			return false;
+		visited[wordIdx] |= mask;
+		return true;
+	}
+
+	uintptr_t heapBase;
+	// compressed pointers cover 4GB from the heap base. so the bitmap is at most 32MB.
+	static constexpr uintptr_t MaxBitmapRange = 1ULL << 32;
+	std::vector<uint64_t> visited; // bitmap of (offset from heap base / object alignment)
+	std::unordered_set<uintptr_t> visitedOutside; // objects out of the bitmap range
+	std::vector<dart::ObjectPtr> worklist;
+	// reused handles
+	dart::Object& obj;
+	dart::Object& fieldObj;
+	dart::Function& func;
+};
+
+void DartApp::walkObject(dart::ObjectPtr objPtr, ObjectWalkState& state)
 {
-	auto cid = obj.GetClassId();
-	if (cid < dart::kNumPredefinedCids) {
-		// objects in array, map, set
-		if (obj.IsArray()) {
-			const auto& arr = dart::Array::Cast(obj);
-			const auto arr_len = arr.Length();
-			if (arr_len > 0) {
+	auto& obj = state.obj;
+	state.worklist.push_back(objPtr);
+	while (!state.worklist.empty()) {
+		const auto ptr = state.worklist.back();
+		state.worklist.pop_back();
+		if (!ptr->IsHeapObject() || !state.Mark(ptr))
+			continue;
+		obj = ptr;
+		// children are pushed in field order. they are reversed after pushing, so the first child is popped first
+		//   and objects are visited in preorder from left to right (same as recursive walking)
+		const auto firstChild = state.worklist.size();
+
+		auto cid = obj.GetClassId();
+		if (cid < dart::kNumPredefinedCids) {
+			// objects in array, map, set
+			if (obj.IsArray()) {
+				const auto& arr = dart::Array::Cast(obj);
+				const auto arr_len = arr.Length();
 				auto arrPtr = dart::Array::DataOf(arr.ptr());
 				for (intptr_t i = 0; i < arr_len; i++) {
-					if (arrPtr->IsHeapObject()) {
-						obj = arrPtr->Decompress(heap_base());
-						walkObject(obj);
-					}
+					if (arrPtr->IsHeapObject())
+						state.worklist.push_back(arrPtr->Decompress(heap_base()));
 					arrPtr++;
 				}
 			}
-		}
-		else if (cid == dart::kConstMapCid || cid == dart::kMapCid) {
-			auto& map = dart::Map::Cast(obj);
-			dart::Map::Iterator iter(map);
-			auto& obj2 = dart::Object::Handle();
-			while (iter.MoveNext()) {
-				obj2 = iter.CurrentKey();
-				walkObject(obj2);
-				obj2 = iter.CurrentValue();
-				walkObject(obj2);
+			else if (cid == dart::kConstMapCid || cid == dart::kMapCid) {
+				auto& map = dart::Map::Cast(obj);
+				dart::Map::Iterator iter(map);
+				while (iter.MoveNext()) {
+					state.worklist.push_back(iter.CurrentKey());
+					state.worklist.push_back(iter.CurrentValue());
+				}
 			}
-		}
-		else if (cid == dart::kConstSetCid || cid == dart::kSetCid) {
-			auto& set = dart::Set::Cast(obj);
-			dart::Set::Iterator iter(set);
-			auto& obj2 = dart::Object::Handle();
-			while (iter.MoveNext()) {
-				obj2 = iter.CurrentKey();
-				walkObject(obj2);
+			else if (cid == dart::kConstSetCid || cid == dart::kSetCid) {
+				auto& set = dart::Set::Cast(obj);
+				dart::Set::Iterator iter(set);
+				while (iter.MoveNext()) {
+					state.worklist.push_back(iter.CurrentKey());
+				}
 			}
-		}
-		else if (obj.IsTypeArguments()) {
-			typeDb->FindOrAdd(dart::TypeArguments::RawCast(obj.ptr()));
-		}
-		else if (obj.IsType()) {
-			typeDb->FindOrAdd(dart::Type::RawCast(obj.ptr()));
-		}
-		else if (obj.IsTypeParameter()) {
-			typeDb->FindOrAdd(dart::TypeParameter::RawCast(obj.ptr()));
-		}
-		else if (obj.IsFunctionType()) {
-			typeDb->FindOrAdd(dart::FunctionType::RawCast(obj.ptr()));
-		}
-		else if (obj.IsFunction()) {
-			const auto& func = dart::Function::Cast(obj);
-			const auto ep_addr = func.entry_point() - base();
-			addFunction(ep_addr, func);
-		}
-		else if (obj.IsClosure()) {
-			const auto& closure = dart::Closure::Cast(obj);
-			const auto ep_addr = closure.entry_point() - base();
-			const auto& func = dart::Function::Handle(closure.function());
-			addFunction(ep_addr, func);
-		}
-		return;
-	}
-
-	ASSERT(obj.IsInstance());
-
-	auto dartCls = classes[cid];
-	ASSERT(dartCls);
-	typeDb->FindOrAdd(*dartCls, dart::Instance::Cast(obj));
-
-	const auto bitmap = dartCls->unboxed_fields_bitmap;
-	auto offset = dart::Instance::NextFieldOffset();
-	const auto ptr = dart::UntaggedObject::ToAddr(obj.ptr());
-	// from InstanceDeserializationCluster::ReadFill() in app_snapshot.cc
-	while (offset < dartCls->size) {
-		if (bitmap.Get(offset / dart::kCompressedWordSize)) {
-			// AOT uses native integer if it is less than 31 bits (compressed pointer)
-			// integer (4/8 bytes) or double (8 bytes)
-			if (dart::kCompressedWordSize == 4) {
-				RELEASE_ASSERT(bitmap.Get((offset + dart::kCompressedWordSize) / dart::kCompressedWordSize));
+			else if (obj.IsTypeArguments()) {
+				typeDb->FindOrAdd(dart::TypeArguments::RawCast(obj.ptr()));
 			}
-			auto p = reinterpret_cast<uint64_t*>(ptr + offset);
-			// it is rare to find integer that larger than 0x1000_0000_0000_0000
-			//   while double is very common because of exponent value
-			// to know exact type (int or double), we have to check from register type in assembly
-			if (*p <= 0x1000000000000000 || *p >= 0xffffffffffff0000) {
-				dartCls->AddField(offset, typeDb->Get(dart::kMintCid));
+			else if (obj.IsType()) {
+				typeDb->FindOrAdd(dart::Type::RawCast(obj.ptr()));
 			}
-			else {
-				dartCls->AddField(offset, typeDb->Get(dart::kDoubleCid));
+			else if (obj.IsTypeParameter()) {
+				typeDb->FindOrAdd(dart::TypeParameter::RawCast(obj.ptr()));
+			}
+			else if (obj.IsFunctionType()) {
+				typeDb->FindOrAdd(dart::FunctionType::RawCast(obj.ptr()));
+			}
+			else if (obj.IsFunction()) {
+				const auto& func = dart::Function::Cast(obj);
+				const auto ep_addr = func.entry_point() - base();
+				addFunction(ep_addr, func);
 			}
-			//std::cout << std::format("    offset_{:x} : int({:#x})\n", offset, *p);
-			offset += dart::kCompressedWordSize * 2;
+			else if (obj.IsClosure()) {
+				const auto& closure = dart::Closure::Cast(obj);
+				const auto ep_addr = closure.entry_point() - base();
+				state.func = closure.function();
+				addFunction(ep_addr, state.func);
+			}
+			std::reverse(state.worklist.begin() + firstChild, state.worklist.end());
+			continue;
 		}
-		else {
-			auto p = reinterpret_cast<dart::CompressedObjectPtr*>(ptr + offset);
-			if (!p->IsHeapObject()) {
-				// SMI. assume Mint but the value is small
-				dartCls->AddField(offset, typeDb->Get(dart::kMintCid));
+
+		ASSERT(obj.IsInstance());
+
+		auto dartCls = classes[cid];
+		ASSERT(dartCls);
+		typeDb->FindOrAdd(*dartCls, dart::Instance::Cast(obj));
+
+		const auto bitmap = dartCls->unboxed_fields_bitmap;
+		auto offset = dart::Instance::NextFieldOffset();
+		const auto addr = dart::UntaggedObject::ToAddr(obj.ptr());
+		// from InstanceDeserializationCluster::ReadFill() in app_snapshot.cc
+		while (offset < dartCls->size) {
+			if (bitmap.Get(offset / dart::kCompressedWordSize)) {
+				// AOT uses native integer if it is less than 31 bits (compressed pointer)
+				// integer (4/8 bytes) or double (8 bytes)
+				if (dart::kCompressedWordSize == 4) {
+					RELEASE_ASSERT(bitmap.Get((offset + dart::kCompressedWordSize) / dart::kCompressedWordSize));
+				}
+				auto p = reinterpret_cast<uint64_t*>(addr + offset);
+				// it is rare to find integer that larger than 0x1000_0000_0000_0000
+				//   while double is very common because of exponent value
+				// to know exact type (int or double), we have to check from register type in assembly
+				if (*p <= 0x1000000000000000 || *p >= 0xffffffffffff0000) {
+					dartCls->AddField(offset, typeDb->Get(dart::kMintCid));
+				}
+				else {
+					dartCls->AddField(offset, typeDb->Get(dart::kDoubleCid));
+				}
+				//std::cout << std::format("    offset_{:x} : int({:#x})\n", offset, *p);
+				offset += dart::kCompressedWordSize * 2;
 			}
 			else {
-				const auto objPtr2 = p->Decompress(heap_base());
-				if (objPtr2.GetClassId() != dart::kNullCid) {
-					if (offset == dartCls->TypeArgumentsOffset()) {
-						ASSERT(objPtr2.GetClassId() == dart::kTypeArgumentsCid);
-						typeDb->FindOrAdd(dart::TypeArguments::RawCast(objPtr2));
-					}
-					else {
-						// compressed object ptr
-						const auto fieldCid = objPtr2.GetClassId();
-						const auto fieldCls = classes[fieldCid];
-						if (fieldCls) {
-							obj = objPtr2;
-							dartCls->AddField(offset, typeDb->FindOrAdd(*fieldCls, dart::Instance::Cast(obj)));
-							// walk this object recursively
-							walkObject(obj);
+				auto p = reinterpret_cast<dart::CompressedObjectPtr*>(addr + offset);
+				if (!p->IsHeapObject()) {
+					// SMI. assume Mint but the value is small
+					dartCls->AddField(offset, typeDb->Get(dart::kMintCid));
+				}
+				else {
+					const auto objPtr2 = p->Decompress(heap_base());
+					if (objPtr2.GetClassId() != dart::kNullCid) {
+						if (offset == dartCls->TypeArgumentsOffset()) {
+							ASSERT(objPtr2.GetClassId() == dart::kTypeArgumentsCid);
+							typeDb->FindOrAdd(dart::TypeArguments::RawCast(objPtr2));
 						}
 						else {
-							//dart::kCallSiteDataCid;
+							// compressed object ptr
+							const auto fieldCid = objPtr2.GetClassId();
+							const auto fieldCls = classes[fieldCid];
+							if (fieldCls) {
+								state.fieldObj = objPtr2;
+								dartCls->AddField(offset, typeDb->FindOrAdd(*fieldCls, dart::Instance::Cast(state.fieldObj)));
+								// walk this object later
+								state.worklist.push_back(objPtr2);
+							}
+							else {
+								//dart::kCallSiteDataCid;
+							}
 						}
 					}
 				}
+				offset += dart::kCompressedWordSize;
 			}
-			offset += dart::kCompressedWordSize;
 		}
+		std::reverse(state.worklist.begin() + firstChild, state.worklist.end());
 	}
-
 }
 
 void DartApp::loadFromObjectPool()
@@ -756,6 +1053,7 @@ void DartApp::loadFromObjectPool()
 	intptr_t num = pool.Length();
 
 	auto& obj = dart::Object::Handle();
+	ObjectWalkState walkState{ heap_base(), dart::Thread::Current()->zone() };
 
 	for (intptr_t i = 0; i < num; i++) {
 		const auto objType = pool.TypeAt(i);
@@ -770,7 +1068,7 @@ void DartApp::loadFromObjectPool()
 					staticFields[dartField->Offset()] = dartField;
 				}
 			}
-			walkObject(obj);
+			walkObject(obj.ptr(), walkState);
 		}
 		else if (objType == dart::ObjectPool::EntryType::kImmediate) {
 			// just immediate. no info
@@ -3,7 +3,13 @@
 #include "DartClass.h"
 #include "DartFunction.h"
 #include "DartStub.h"
+#include "FnAddressIndex.h"
+#include <map>
 #include <unordered_map>
+#include <mutex>
+#include <span>
+
+struct ObjectWalkState;
 
 class DartApp
 {
@@ -16,18 +22,38 @@ public:
 	void ExitScope();
 
 	void LoadInfo();
+	// free analysis result of all functions
+	void ReleaseAnalyzedData();
+
+	// snapshot hash string in VM snapshot header. it is changed when Dart version or snapshot flags are changed
+	std::string SnapshotHash() const;
 
 	intptr_t base() const { return (intptr_t)lib_base; }
 	uint32_t offset(intptr_t addr) const { return (uint32_t)(addr - base()); }
 	uintptr_t heap_base() const { return heap_base_; }
 
 	DartClass* GetClass(intptr_t cid);
+	// function or stub at the address. a stub containing the address is split (duplicated stubs in one big stub).
 	DartFnBase* GetFunction(uint64_t addr);
+	// function or stub containing the address. unlike GetFunction(), it never splits a stub (read only lookup).
+	DartFnBase* FindFunction(uint64_t addr);
+	// same as GetFunction() for many addresses at once
+	void GetFunctions(std::span<const uint64_t> addrs, std::span<DartFnBase*> results);
+	// all stubs (including split stubs) sorted by address
+	std::vector<DartStub*> Stubs();
+	// address ranges of all functions and stubs. available after LoadInfo()
+	const FnAddressIndex& AddressIndex() const { return addressIndex; }
 	DartField* GetStaticField(intptr_t offset) { return staticFields.at(offset); }
 
 	dart::ObjectPool& GetObjectPool() { return *ppool; }
+	// text that identifies the Object Pool entry at the offset. it does not contain any address, so it can be compared between builds.
+	std::string PoolObjectDigest(uint64_t offset);
 	DartTypeDb* TypeDb() { return typeDb.get(); }
 
+	size_t NumLibraries() const { return libs.size(); }
+	size_t NumFunctions() const { return functions.size(); }
+	size_t NumStubs() const { return stubs.size(); }
+
 	intptr_t DartIntCid() const { return dartIntCid; }
 	intptr_t DartFutureCid() const { return dartFutureCid; }
 
@@ -36,14 +62,18 @@ private:
 	DartLibrary* addLibrary(const dart::Library& library);
 	void loadFromClassTable(dart::IsolateGroup* ig);
 	void loadStubs(dart::ObjectStore* store);
+	void checkVMStub(const dart::Code& code, uint64_t ep_addr, const char* name);
 	DartFunction* addFunctionNoCheck(const dart::Function& func);
 	void addFunction(uintptr_t ep_addr, const dart::Function& func);
 	void findFunctionInHeap();
 	void finalizeFunctionsInfo();
+	void buildAddressIndex();
+	DartStub* splitStub(const FnAddressIndex::Entry& entry, uint64_t addr);
 	void loadFromObjectPool();
-	void walkObject(dart::Object& obj); // to check field types from existed object
+	void walkObject(dart::ObjectPtr objPtr, ObjectWalkState& state); // to check field types from existed object
 
 	const void* lib_base;
+	size_t lib_size;
 	const uint8_t* vm_snapshot_data;
 	const uint8_t* vm_snapshot_instructions;
 	const uint8_t* isolate_snapshot_data;
@@ -62,6 +92,10 @@ private:
 	std::vector<DartClass*> topClasses;
 	std::unordered_map<uint64_t, DartFunction*> functions;
 	std::unordered_map<uint64_t, DartStub*> stubs;
+	// stubs that are split from stubs in index. stubs and index are never modified after LoadInfo()
+	std::map<uint64_t, DartStub*> splitStubs;
+	std::mutex stubsMutex;
+	FnAddressIndex addressIndex;
 	std::unordered_map<uint64_t, DartField*> staticFields;
 	std::unique_ptr<DartTypeDb> typeDb;
 
@@ -79,9 +113,13 @@ private:
 
 	intptr_t throwStubAddr;
 
+	friend class AnalysisCache;
+	friend class AppFingerprint;
 	friend class CodeAnalyzer;
 	friend class DartAnalyzer;
 	friend class DartDumper;
 	friend class FridaWriter;
+	friend class ModelExporter;
+	friend class QueryServer;
 };
 
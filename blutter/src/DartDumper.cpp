@@ -6,10 +6,12 @@
 #include <ranges>
 #include <iostream>
 #include <sstream>
-#include <numeric>
 #include "Disassembler.h"
 #include "DartThreadInfo.h"
+#include "OutputFile.h"
 #include "CodeAnalyzer.h"
+#include "CodeFilter.h"
+#include "WorkerPool.h"
 
 // TODO: move arm64 specific code to *_arm64 file
 
@@ -85,7 +87,7 @@ static std::string getFunctionName4Ida(const DartFunction& dartFn, const std::st
 void DartDumper::Dump4Ida(std::filesystem::path outDir)
 {
 	std::filesystem::create_directory(outDir);
-	std::ofstream of((outDir / "addNames.py").string());
+	OutputFile of(outDir / "addNames.py");
 	of << "import ida_funcs\n";
 	of << "import idaapi\n\n";
 
@@ -98,35 +100,34 @@ void DartDumper::Dump4Ida(std::filesystem::path outDir)
 				auto name = getFunctionName4Ida(*dartFn, cls_prefix);
 				const auto fnSize = dartFn->Size();
 				if (fnSize > 0) {
-					of << std::format("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + fnSize);
+					OutputFile::Format(of, "ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + fnSize);
 				}
-				of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}\")\n", ep, lib_prefix, cls_prefix, name.c_str(), ep);
+				OutputFile::Format(of, "idaapi.set_name({:#x}, \"{}_{}::{}_{:x}\")\n", ep, lib_prefix, cls_prefix, name.c_str(), ep);
 				if (dartFn->HasMorphicCode()) {
 					const auto payloadAddr = dartFn->PayloadAddress();
 					const auto morphicAddr = dartFn->MonomorphicAddress();
 					if (payloadAddr != 0 && payloadAddr != ep) {
-						of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_miss\")\n", payloadAddr, lib_prefix, cls_prefix, name.c_str(), ep);
+						OutputFile::Format(of, "idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_miss\")\n", payloadAddr, lib_prefix, cls_prefix, name.c_str(), ep);
 					}
 					if (morphicAddr != 0 && morphicAddr != ep && morphicAddr != payloadAddr) {
-						of << std::format("idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_check\")\n", morphicAddr, lib_prefix, cls_prefix, name.c_str(), ep);
+						OutputFile::Format(of, "idaapi.set_name({:#x}, \"{}_{}::{}_{:x}_check\")\n", morphicAddr, lib_prefix, cls_prefix, name.c_str(), ep);
 					}
 				}
 			}
 		}
 	}
 
-	for (auto& item : app.stubs) {
-		auto stub = item.second;
+	for (auto stub : app.Stubs()) {
 		const auto ep = stub->Address();
 		auto name = stub->FullName();
 		std::replace(name.begin(), name.end(), '<', '@');
 		std::replace(name.begin(), name.end(), '>', '@');
 		std::replace(name.begin(), name.end(), ',', '&');
 		std::replace(name.begin(), name.end(), ' ', '_');
-		of << std::format("idaapi.set_name({:#x}, \"{}_{:x}\")\n", ep, name.c_str(), ep);
+		OutputFile::Format(of, "idaapi.set_name({:#x}, \"{}_{:x}\")\n", ep, name.c_str(), ep);
 		if (stub->Size() == 0)
 			continue;
-		of << std::format("ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + stub->Size());
+		OutputFile::Format(of, "ida_funcs.add_func({:#x}, {:#x})\n", ep, ep + stub->Size());
 	}
 
 
@@ -156,11 +157,12 @@ def create_Dart_structs():
 	applyStruct4Ida(of);
 
 	of << "print('Script finished!')\n";
+	of.Close();
 }
 
 std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(std::string outFile)
 {
-	std::ofstream of(outFile);
+	OutputFile of(outFile);
 
 	const auto max_offset = GetThreadMaxOffset();
 	auto padNo = 0;
@@ -217,8 +219,9 @@ std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(s
 			else {
 				// TODO: more meaningful variable name
 				name = std::format("Obj_{:#x}", offset);
-				auto comment = ObjectToString(obj);
-				comments.push_back(std::make_pair(offset, comment));
+				// reuse the full form description without "[pp+0x...] " prefix
+				const auto& desc = getPoolDescription(offset, false);
+				comments.push_back(std::make_pair(offset, desc.substr(desc.find("] ") + 2)));
 			}
 		}
 		else if (objType == dart::ObjectPool::EntryType::kImmediate) {
@@ -238,10 +241,19 @@ std::vector<std::pair<intptr_t, std::string>> DartDumper::DumpStructHeaderFile(s
 	}
 
 	of << "} DartObjectPool;\n";
+	of.Close();
 
 	return comments;
 }
 
+static void writeStructOperands(std::ostream& of, const std::vector<StructOperandRef>& refs, uint64_t baseAddr)
+{
+	for (const auto& ref : refs) {
+		of << "ida_ua.decode_insn(insn, " << baseAddr + ref.offset << ")\n";
+		of << "idc.op_stroff(insn, " << (int)ref.opIdx << (ref.base == StructOperandRef::Thread ? ", thrs, 0)\n" : ", pps, 0)\n");
+	}
+}
+
 void DartDumper::applyStruct4Ida(std::ostream& of)
 {
 	Disassembler disasmer;
@@ -250,39 +262,30 @@ void DartDumper::applyStruct4Ida(std::ostream& of)
 	of << "insn = ida_ua.insn_t()\n";
 
 	for (auto lib : app.libs) {
-		if (lib->isInternal)
+		if (lib->isInternal || (filter && !filter->MatchLibrary(*lib)))
 			continue;
 
 		for (auto dartCls : lib->classes) {
+			if (filter && !filter->MatchClass(*dartCls))
+				continue;
 			for (auto dartFn : dartCls->Functions()) {
-				if (dartFn->PayloadSize() == 0)
+				if (dartFn->PayloadSize() == 0 || (filter && !filter->MatchFunction(*dartFn)))
 					continue;
 
-				auto insns = disasmer.Disasm((uint8_t*)dartFn->PayloadAddress() + app.base(), dartFn->PayloadSize(), dartFn->Address());
-
-				for (uint32_t i = 0; i < insns.Count(); i++) {
-					auto insn = insns.At(i);
-					const auto op_count = insn.op_count();
-
-					for (uint8_t j = 0; j < op_count; j++) {
-						auto reg = ARM64_REG_INVALID;
-						if (insn.ops[j].type == ARM64_OP_REG)
-							reg = insn.ops[j].reg;
-						else if (insn.ops[j].type == ARM64_OP_MEM)
-							reg = insn.ops[j].mem.base;
-						if (reg == CSREG_DART_THR) {
-							of << "ida_ua.decode_insn(insn, " << insn.address() << ")\n";
-							of << "idc.op_stroff(insn, " << (int)j << ", thrs, 0)\n";
-							break;
-						}
-						else if (reg == CSREG_DART_PP) {
-							// TODO: if it is not MEM operand, reg cannot be struct offset
-							of << "ida_ua.decode_insn(insn, " << insn.address() << ")\n";
-							of << "idc.op_stroff(insn, " << (int)j << ", pps, 0)\n";
-							break;
-						}
-					}
+				const auto& refs = dartFn->StructOperands();
+				if (!refs) {
+					// function is not analyzed. disassemble whole payload.
+					auto insns = disasmer.Disasm((uint8_t*)dartFn->PayloadAddress() + app.base(), dartFn->PayloadSize(), dartFn->PayloadAddress());
+					writeStructOperands(of, FindStructOperands(insns), dartFn->PayloadAddress());
+					continue;
 				}
+
+				// operands from entry point are recorded by analyzer. only code before entry point (monomorphic check) is disassembled here.
+				if (dartFn->Address() > dartFn->PayloadAddress()) {
+					auto insns = disasmer.Disasm((uint8_t*)dartFn->PayloadAddress() + app.base(), dartFn->Address() - dartFn->PayloadAddress(), dartFn->PayloadAddress());
+					writeStructOperands(of, FindStructOperands(insns), dartFn->PayloadAddress());
+				}
+				writeStructOperands(of, *refs, dartFn->Address());
 			}
 		}
 	}
@@ -299,109 +302,267 @@ const std::string& DartDumper::getQuoteString(dart::Object& obj)
 	return txt;
 }
 
-void DartDumper::DumpCode(const char* out_dir)
+bool DartDumper::isLibrarySelected(DartLibrary& dartLib) const
 {
-	std::filesystem::create_directory(out_dir);
+	if (dartLib.isInternal)
+		return false;
+	if (filter == nullptr)
+		return true;
+	if (!filter->MatchLibrary(dartLib))
+		return false;
+	if (!filter->HasFunctionSelection())
+		return true;
+	return std::any_of(dartLib.classes.begin(), dartLib.classes.end(), [this](DartClass* dartCls) { return isClassSelected(*dartCls); });
+}
 
-	Disassembler disasmer;
+bool DartDumper::isClassSelected(DartClass& dartCls) const
+{
+	if (filter == nullptr)
+		return true;
+	if (!filter->MatchClass(dartCls))
+		return false;
+	if (!filter->HasFunctionSelection())
+		return true;
+	const auto& fns = dartCls.Functions();
+	return std::any_of(fns.begin(), fns.end(), [this](DartFunction* dartFn) { return filter->MatchFunction(*dartFn); });
+}
+
+void DartDumper::DumpCode(const char* out_dir, CodeAnalyzer* analyzer)
+{
+	std::filesystem::create_directory(out_dir);
 
+	// creating directories is done here because libraries might share a directory
+	std::vector<DartLibrary*> dartLibs;
+	std::vector<std::string> outFiles;
 	for (auto dartLib : app.libs) {
-		if (dartLib->isInternal)
+		if (!isLibrarySelected(*dartLib))
 			continue;
+		dartLibs.push_back(dartLib);
+		outFiles.push_back(dartLib->CreatePath(out_dir));
+	}
+
+	// each library is written to its own file
+	WorkerPool::ParallelFor(numJobs, dartLibs.size(), [&](unsigned, size_t idx) {
+		auto dartLib = dartLibs[idx];
+#ifndef NO_CODE_ANALYSIS
+		if (analyzer)
+			analyzer->AnalyzeLibrary(*dartLib);
+#endif
+		{
+			OutputFile of(outFiles[idx]);
+			dumpLibraryCode(of, dartLib);
+			of.Close();
+		}
+#ifndef NO_CODE_ANALYSIS
+		if (analyzer)
+			CodeAnalyzer::ReleaseLibrary(*dartLib);
+#endif
+	});
+}
 
-		auto out_file = dartLib->CreatePath(out_dir);
-		std::ofstream of(out_file);
-		dartLib->PrintCommentInfo(of);
+#ifndef NO_CODE_ANALYSIS
+// reused for dumping all functions in a library
+struct AsmDumpBuffers {
+	Disassembler textDisasmer{ false };
+	std::string text;
+	std::vector<uint64_t> callAddrs;
+	std::vector<DartFnBase*> callTargets;
+};
 
-		for (auto dartCls : dartLib->classes) {
-			dartCls->PrintHead(of);
+void DartDumper::DumpFunctionAsm(std::ostream& of, DartFunction& dartFn)
+{
+	AsmDumpBuffers buffers;
+	dumpFunctionAsm(of, dartFn, buffers);
+}
 
-			if (!dartCls->Fields().empty())
-				of << "\n";
-			for (auto dartField : dartCls->Fields()) {
-				dartField->Print(of);
+void DartDumper::dumpFunctionAsm(std::ostream& of, DartFunction& dartFn, AsmDumpBuffers& buffers)
+{
+	if (dartFn.Size() == 0)
+		return;
+
+	// use as app is loaded at zero
+	auto& fnAsmTexts = dartFn.GetAnalyzedData()->asmTexts;
+	auto& asmTexts = fnAsmTexts.Data();
+	auto& ils = dartFn.GetAnalyzedData()->ils;
+	size_t ilIdx = 0;
+	AddrRange range;
+	ASSERT(!asmTexts.empty());
+	// assembly text is rendered only here. disassembling without detail again is cheap.
+	auto insns = buffers.textDisasmer.Disasm((uint8_t*)dartFn.MemAddress(), dartFn.Size(), dartFn.Address());
+	ASSERT(insns.Count() == asmTexts.size());
+	// resolve all call targets of the function at once
+	buffers.callAddrs.clear();
+	for (auto& asmText : asmTexts) {
+		if (asmText.dataType == AsmText::Call)
+			buffers.callAddrs.push_back(asmText.callAddress);
+	}
+	buffers.callTargets.resize(buffers.callAddrs.size());
+	app.GetFunctions(buffers.callAddrs, buffers.callTargets);
+	size_t callIdx = 0;
+	for (size_t i = 0; i < asmTexts.size(); i++) {
+		auto& asmText = asmTexts[i];
+		const auto addr = fnAsmTexts.Address(asmText);
+		RenderAsmText(insns.Ptr(i), buffers.text);
+		std::string extra;
+		switch (asmText.dataType) {
+		case AsmText::ThreadOffset:
+			extra = "THR::" + GetThreadOffsetName(asmText.threadOffset);
+			break;
+		case AsmText::PoolOffset:
+			extra = getPoolDescription(asmText.poolOffset);
+			break;
+		case AsmText::Boolean:
+			extra = asmText.boolVal ? "true" : "false";
+			break;
+		case AsmText::Call: {
+			auto* fn = buffers.callTargets[callIdx++];
+			if (fn) {
+				extra = fn->FullName();
+				auto retCid = fn->ReturnType();
+				if (retCid != dart::kIllegalCid) {
+					auto retCls = app.classes.at(retCid);
+					extra += std::format(" -> {} (size={:#x})", retCls->FullName(), retCls->Size());
+				}
 			}
+			break;
+		}
+		}
 
-			if (!dartCls->Functions().empty())
-				of << "\n";
-			for (auto dartFn : dartCls->Functions()) {
-				dartFn->PrintHead(of);
+		of << "    // ";
 
-#ifndef NO_CODE_ANALYSIS
-				// use as app is loaded at zero
-				if (dartFn->Size() > 0) {
-					auto& asmTexts = dartFn->GetAnalyzedData()->asmTexts.Data();
-					auto& il_insns = dartFn->GetAnalyzedData()->il_insns;
-					auto il_itr = il_insns.begin();
-					AddrRange range;
-					ASSERT(!asmTexts.empty());
-					for (auto& asmText : asmTexts) {
-						std::string extra;
-						switch (asmText.dataType) {
-						case AsmText::ThreadOffset:
-							extra = "THR::" + GetThreadOffsetName(asmText.threadOffset);
-							break;
-						case AsmText::PoolOffset:
-							extra = getPoolObjectDescription(asmText.poolOffset);
-							break;
-						case AsmText::Boolean:
-							extra = asmText.boolVal ? "true" : "false";
-							break;
-						case AsmText::Call: {
-							auto* fn = app.GetFunction(asmText.callAddress);
-							if (fn) {
-								extra = fn->FullName();
-								auto retCid = fn->ReturnType();
-								if (retCid != dart::kIllegalCid) {
-									auto retCls = app.classes.at(retCid);
-									extra += std::format(" -> {} (size={:#x})", retCls->FullName(), retCls->Size());
-								}
-							}
-							break;
-						}
-						}
-
-						of << "    // ";
-
-						if (range.Has(asmText.addr)) {
-							of << "    ";
-						}
-						else {
-							while ((*il_itr)->Start() < asmText.addr) {
-								if ((*il_itr)->Kind() != ILInstr::Unknown) {
-									of << std::format("{:#x}: {}\n", (*il_itr)->Start(), (*il_itr)->ToString());
-									of << "    // ";
-								}
-								++il_itr;
-							}
-							if ((*il_itr)->Start() == asmText.addr) {
-								if ((*il_itr)->Kind() != ILInstr::Unknown) {
-									of << std::format("{:#x}: {}\n", asmText.addr, (*il_itr)->ToString());
-									of << "    //     ";
-									range = (*il_itr)->Range();
-								}
-								++il_itr;
-							}
-						}
-
-						if (extra.empty())
-							of << std::format("{:#x}: {}\n", asmText.addr, &asmText.text[0]);
-						else
-							of << std::format("{:#x}: {}  ; {}\n", asmText.addr, &asmText.text[0], extra);
-					}
+		if (range.Has(addr)) {
+			of << "    ";
+		}
+		else {
+			while (ilIdx < ils.Size() && ils.Start(ilIdx) < addr) {
+				if (ils.Kind(ilIdx) != ILInstr::Unknown) {
+					OutputFile::Format(of, "{:#x}: {}\n", ils.Start(ilIdx), ils.Text(ilIdx));
+					of << "    // ";
 				}
-#endif // NO_CODE_ANALYSIS
-
-				dartFn->PrintFoot(of);
+				++ilIdx;
+			}
+			if (ilIdx < ils.Size() && ils.Start(ilIdx) == addr) {
+				if (ils.Kind(ilIdx) != ILInstr::Unknown) {
+					OutputFile::Format(of, "{:#x}: {}\n", addr, ils.Text(ilIdx));
+					of << "    //     ";
+					range = ils.Range(ilIdx);
+				}
+				++ilIdx;
 			}
+		}
+
+		if (extra.empty())
+			OutputFile::Format(of, "{:#x}: {}\n", addr, buffers.text);
+		else
+			OutputFile::Format(of, "{:#x}: {}  ; {}\n", addr, buffers.text, extra);
+	}
+}
+#endif
+
+void DartDumper::dumpLibraryCode(std::ostream& of, DartLibrary* dartLib)
+{
+#ifndef NO_CODE_ANALYSIS
+	AsmDumpBuffers buffers;
+#endif
+	dartLib->PrintCommentInfo(of);
+
+	for (auto dartCls : dartLib->classes) {
+		if (!isClassSelected(*dartCls))
+			continue;
+		dartCls->PrintHead(of);
+
+		if (!dartCls->Fields().empty())
+			of << "\n";
+		for (auto dartField : dartCls->Fields()) {
+			dartField->Print(of);
+		}
 
-			dartCls->PrintFoot(of);
+		if (!dartCls->Functions().empty())
+			of << "\n";
+		for (auto dartFn : dartCls->Functions()) {
+			if (filter && !filter->MatchFunction(*dartFn))
+				continue;
+			dartFn->PrintHead(of);
+
+#ifndef NO_CODE_ANALYSIS
+			dumpFunctionAsm(of, *dartFn, buffers);
+#endif
+
+			dartFn->PrintFoot(of);
 		}
+
+		dartCls->PrintFoot(of);
+	}
+}
+
+const std::string& DartDumper::getPoolDescription(intptr_t offset, bool simpleForm)
+{
+	const auto idx = dart::ObjectPool::IndexFromOffset(offset);
+	auto& descs = simpleForm ? simplePoolDescs : fullPoolDescs;
+
+	// ObjectToString() is not thread safe. render each description only once with the exclusive lock
+	{
+		std::shared_lock lock(poolDescsMutex);
+		if (idx < (intptr_t)descs.size() && !descs[idx].empty())
+			return descs[idx];
+	}
+	std::unique_lock lock(poolDescsMutex);
+	// the vector is never resized after this. a returned reference is valid until the dumper is destroyed.
+	if (descs.empty())
+		descs.resize(app.GetObjectPool().Length());
+	auto& desc = descs[idx];
+	if (desc.empty())
+		desc = getPoolObjectDescription(offset, simpleForm);
+	return desc;
+}
+
+void DartDumper::SetRenderLimits(unsigned maxElements, size_t blobMinSize, std::filesystem::path blobDir)
+{
+	this->maxElements = maxElements;
+	this->blobMinSize = blobMinSize;
+	this->blobDir = std::move(blobDir);
+}
+
+template <typename T>
+void DartDumper::appendTypedData(std::string& txt, const T* data, intptr_t len)
+{
+	// append to the buffer directly. accumulating std::string copies whole text for every element.
+	const auto num = maxElements != 0 ? std::min(len, (intptr_t)maxElements) : len;
+	txt.reserve(txt.size() + num * (sizeof(T) * 2 + 4) + 8);
+	auto out = std::back_inserter(txt);
+	txt += '[';
+	for (intptr_t i = 0; i < num; i++) {
+		if (i != 0)
+			txt += ", ";
+		if constexpr (std::is_floating_point_v<T>)
+			std::format_to(out, "{}", data[i]);
+		else
+			std::format_to(out, "{:#x}", data[i]);
 	}
+	if (num < len)
+		txt += ", ...";
+	txt += ']';
 }
 
-// collect instance ptr to dump the full contents in DumpObjects()
-static std::set<intptr_t> knownObjectPtrs;
+std::string DartDumper::writeBlob(const dart::TypedData& arr)
+{
+	const auto heapOffset = dart::UntaggedObject::ToAddr(arr.ptr()) - app.heap_base();
+	const auto filename = std::format("{:#x}.bin", heapOffset);
+	// same object might be rendered in simple and full form
+	if (writtenBlobs.insert(heapOffset).second) {
+		std::filesystem::create_directories(blobDir);
+		std::ofstream of(blobDir / filename, std::ios::binary);
+		if (!of)
+			throw std::runtime_error(std::format("Cannot create blob file {}", (blobDir / filename).string()));
+		of.write((const char*)arr.DataAddr(0), arr.LengthInBytes());
+	}
+	return (blobDir.filename() / filename).string();
+}
+
+bool DartDumper::isElementLimitReached(intptr_t cnt) const
+{
+	return maxElements != 0 && cnt >= (intptr_t)maxElements;
+}
 
 std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool nestedObj, int depth)
 {
@@ -417,64 +578,54 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 
 	// use TypedData or TypedDataBase ?
 	if (obj.IsTypedData()) {
-		//dart::kTypedDataInt32ArrayCid;
 		auto& arr = dart::TypedData::Cast(obj);
 		const auto arr_len = arr.Length();
-		auto ptr = arr.DataAddr(0);
+		const auto& clsName = app.GetClass(cid)->Name();
+		if (blobMinSize != 0 && arr.LengthInBytes() >= (intptr_t)blobMinSize)
+			return std::format("{}({}) blob: {}", clsName, arr_len, writeBlob(arr));
+
 		std::string txt;
 		if (arr_len > 0) {
+			auto ptr = arr.DataAddr(0);
 			switch (arr.ElementType()) {
-#define ACCUMLATE(type) { \
-	auto data = (type*)ptr; \
-	txt = std::accumulate(data + 1, data + arr_len, std::format("[{:#x}", data[0]), [](std::string x, type y) { return x + ", " + std::format("{:#x}", y); } ); \
-}
 			case dart::kInt8ArrayElement:
-				ACCUMLATE(int8_t);
+				appendTypedData(txt, (int8_t*)ptr, arr_len);
 				break;
 			case dart::kUint8ArrayElement:
 			case dart::kUint8ClampedArrayElement:
-				ACCUMLATE(uint8_t);
+				appendTypedData(txt, (uint8_t*)ptr, arr_len);
 				break;
 			case dart::kInt16ArrayElement:
-				ACCUMLATE(int16_t);
+				appendTypedData(txt, (int16_t*)ptr, arr_len);
 				break;
 			case dart::kUint16ArrayElement:
-				ACCUMLATE(uint16_t);
+				appendTypedData(txt, (uint16_t*)ptr, arr_len);
 				break;
 			case dart::kInt32ArrayElement:
-				ACCUMLATE(int32_t);
+				appendTypedData(txt, (int32_t*)ptr, arr_len);
 				break;
 			case dart::kUint32ArrayElement:
-				ACCUMLATE(uint32_t);
+				appendTypedData(txt, (uint32_t*)ptr, arr_len);
 				break;
 			case dart::kInt64ArrayElement:
-				ACCUMLATE(int64_t);
+				appendTypedData(txt, (int64_t*)ptr, arr_len);
 				break;
 			case dart::kUint64ArrayElement:
-				ACCUMLATE(uint64_t);
+				appendTypedData(txt, (uint64_t*)ptr, arr_len);
 				break;
-#undef ACCUMLATE
-#define ACCUMLATE(type) { \
-	auto data = (type*)ptr; \
-	txt = std::accumulate(data + 1, data + arr_len, std::format("[{}", data[0]), [](std::string x, type y) { return x + ", " + std::format("{}", y); } ); \
-}
 			case dart::kFloat32ArrayElement:
-				ACCUMLATE(float);
+				appendTypedData(txt, (float*)ptr, arr_len);
 				break;
 			case dart::kFloat64ArrayElement:
-				ACCUMLATE(double);
+				appendTypedData(txt, (double*)ptr, arr_len);
 				break;
-#undef ACCUMLATE
 			case dart::kFloat32x4ArrayElement:
 			case dart::kInt32x4ArrayElement:
 			case dart::kFloat64x2ArrayElement:
 				FATAL("TODO: simd array");
 			}
-
-			txt += ']';
 		}
-		//arr.ElementSizeInBytes();
-		return std::format("{}({}) {}", app.GetClass(cid)->Name(), arr_len, txt);
+		return std::format("{}({}) {}", clsName, arr_len, txt);
 	}
 
 	switch (cid) {
@@ -551,26 +702,31 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 		if (simpleForm && typeArg->Length() > 0)
 			return std::format("List{}({})", typeArg->ToString(), arr_len);
 
-		std::ostringstream ss;
+		auto txt = std::format("List{}({}) [", typeArg->ToString(), arr_len);
 		if (arr_len > 0) {
 			// in ImmutableList here, only Dart type (native type is not used)
 			auto arrPtr = dart::Array::DataOf(arr.ptr());
 			for (intptr_t i = 0; i < arr_len; i++) {
 				if (i != 0)
-					ss << ", ";
+					txt += ", ";
+				if (isElementLimitReached(i)) {
+					txt += "...";
+					break;
+				}
 
 				if (arrPtr->IsHeapObject()) {
 					obj = arrPtr->Decompress(app.heap_base());
-					ss << ObjectToString(obj, simpleForm, nestedObj, depth + 1);
+					txt += ObjectToString(obj, simpleForm, nestedObj, depth + 1);
 				}
 				else {
 					obj = arrPtr->DecompressSmi();
-					ss << std::hex << std::showbase << dart::Smi::Cast(obj).Value();
+					std::format_to(std::back_inserter(txt), "{:#x}", dart::Smi::Cast(obj).Value());
 				}
 				arrPtr++;
 			}
 		}
-		return std::format("List{}({}) [{}]", typeArg->ToString(), arr_len, ss.str());
+		txt += ']';
+		return txt;
 	}
 #ifdef HAS_RECORD_TYPE
 	case dart::kRecordCid: {
@@ -625,7 +781,12 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 		auto& val = dart::Object::Handle();
 		int cnt = 0;
 		while (iter.MoveNext()) {
-			if (cnt++) ss << ",\n";
+			if (cnt) ss << ",\n";
+			if (isElementLimitReached(cnt)) {
+				ss << indent << "...";
+				break;
+			}
+			cnt++;
 			key = iter.CurrentKey();
 			val = iter.CurrentValue();
 			// key always be simple form
@@ -647,8 +808,13 @@ std::string DartDumper::ObjectToString(dart::Object& obj, bool simpleForm, bool
 		auto& key = dart::Object::Handle();
 		int cnt = 0;
 		while (iter.MoveNext()) {
-			if (cnt++)
+			if (cnt)
 				ss << ", ";
+			if (isElementLimitReached(cnt)) {
+				ss << "...";
+				break;
+			}
+			cnt++;
 			key = iter.CurrentKey();
 			ss << ObjectToString(key, simpleForm, nestedObj, depth + 1);
 		}
@@ -865,28 +1031,29 @@ std::string DartDumper::getPoolObjectDescription(intptr_t offset, bool simpleFor
 
 void DartDumper::DumpObjectPool(const char* filename)
 {
-	std::ofstream of(filename);
+	OutputFile of(filename);
 	const auto& pool = app.GetObjectPool();
 	intptr_t num = pool.Length();
 
 	const auto& rawObj = pool.ptr()->untag();
 	const auto raw_addr = dart::UntaggedObject::ToAddr(rawObj);
-	of << std::format("pool heap offset: {:#x}\n", raw_addr - app.heap_base());
+	OutputFile::Format(of, "pool heap offset: {:#x}\n", raw_addr - app.heap_base());
 
 	for (intptr_t i = 0; i < num; i++) {
 		// offset here is from ObjectPool pointer subtracted by kHeapObjectTag
 		// add 1 to make the offset value same as offset in compiled code
 		intptr_t offset = dart::ObjectPool::OffsetFromIndex(i);
-		auto txt = getPoolObjectDescription(offset + 1, false);
+		const auto& txt = getPoolDescription(offset + 1, false);
 		of << txt << "\n";
 		if (txt.compare(txt.find(']'), 15, "] UnlinkedCall:") == 0)
 			i++;
 	}
+	of.Close();
 }
 
 void DartDumper::DumpObjects(const char* filename)
 {
-	std::ofstream of(filename);
+	OutputFile of(filename);
 
 	auto& obj = dart::Object::Handle();
 	for (auto objPtr : knownObjectPtrs) {
@@ -896,4 +1063,5 @@ void DartDumper::DumpObjects(const char* filename)
 		of << dumpInstance(obj, simpleForm, nestedObj, 0);
 		of << "\n\n";
 	}
+	of.Close();
 }
@@ -1,34 +1,86 @@
 #pragma once
 #include "DartApp.h"
 #include <filesystem>
+#include <set>
+#include <shared_mutex>
+#include <unordered_set>
+
+struct AsmDumpBuffers;
+class CodeFilter;
 
 class DartDumper
 {
 public:
-	DartDumper(DartApp& app) : app(app) {};
+	// numJobs is number of threads for DumpCode(). the output is same for any number of threads.
+	DartDumper(DartApp& app, unsigned numJobs = 1) : app(app), numJobs(numJobs) {};
 
 	void Dump4Ida(std::filesystem::path outDir);
 
 	std::vector<std::pair<intptr_t, std::string>> DumpStructHeaderFile(std::string outFile);
 
-	void DumpCode(const char* out_dir);
+	// if analyzer is given (streaming mode), each library is analyzed before dumping it and the analysis result
+	// is freed after that. so only analysis of libraries being dumped is kept in memory.
+	void DumpCode(const char* out_dir, CodeAnalyzer* analyzer = nullptr);
+
+#ifndef NO_CODE_ANALYSIS
+	// assembly with IL of an analyzed function as in asm folder
+	void DumpFunctionAsm(std::ostream& of, DartFunction& dartFn);
+#endif
 
 	void DumpObjectPool(const char* filename);
 	void DumpObjects(const char* filename);
 
+	// maxElements limits the number of rendered elements of TypedData, List, Map and Set (0 for no limit).
+	// TypedData with at least blobMinSize bytes is written to a file in blobDir instead of text (0 for never).
+	// must be set before dumping because rendered object pool descriptions are cached.
+	void SetRenderLimits(unsigned maxElements, size_t blobMinSize, std::filesystem::path blobDir);
+	// only code selected by the filter is dumped to asm folder and applied struct offsets for IDA
+	void SetFilter(const CodeFilter* filter) { this->filter = filter; }
+
 	std::string ObjectToString(dart::Object& obj, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 
 private:
 	std::string getPoolObjectDescription(intptr_t offset, bool simpleForm = true);
+	// cached getPoolObjectDescription(). it is thread safe and each entry is rendered only once per form.
+	const std::string& getPoolDescription(intptr_t offset, bool simpleForm = true);
+
+	// a library or class is dumped if it is selected by the filter and it contains a selected function (when the filter selects functions)
+	bool isLibrarySelected(DartLibrary& dartLib) const;
+	bool isClassSelected(DartClass& dartCls) const;
+	void dumpLibraryCode(std::ostream& of, DartLibrary* dartLib);
+#ifndef NO_CODE_ANALYSIS
+	void dumpFunctionAsm(std::ostream& of, DartFunction& dartFn, AsmDumpBuffers& buffers);
+#endif
 
 	std::string dumpInstance(dart::Object& obj, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 	std::string dumpInstanceFields(dart::Object& obj, DartClass& dartCls, intptr_t ptr, intptr_t offset, bool simpleForm = false, bool nestedObj = false, int depth = 0);
 
+	template <typename T>
+	void appendTypedData(std::string& txt, const T* data, intptr_t len);
+	// returns path of the blob file relative to output directory
+	std::string writeBlob(const dart::TypedData& arr);
+	bool isElementLimitReached(intptr_t cnt) const;
+
 	void applyStruct4Ida(std::ostream& of);
 
 	const std::string& getQuoteString(dart::Object& obj);
 
 	DartApp& app;
+	unsigned numJobs;
+	const CodeFilter* filter{ nullptr };
+	unsigned maxElements{ 0 };
+	size_t blobMinSize{ 0 };
+	std::filesystem::path blobDir;
+	std::unordered_set<intptr_t> writtenBlobs;
+	// collect instance ptr to dump the full contents in DumpObjects()
+	std::set<intptr_t> knownObjectPtrs;
+	// object pool descriptions (index by pool index) shared by all dumps. empty string is not rendered yet.
+	std::vector<std::string> simplePoolDescs;
+	std::vector<std::string> fullPoolDescs;
+	std::shared_mutex poolDescsMutex;
 	// map for object ptr to unescape string with quote
 	std::unordered_map<intptr_t, std::string> quoteStringCache;
+
+	friend class ModelExporter;
+	friend class QueryServer;
 };
@@ -1,6 +1,7 @@
 #pragma once
 #include "DartFnBase.h"
 #include "CodeAnalyzer.h"
+#include <optional>
 
 class DartClass;
 class DartApp;
@@ -25,11 +26,11 @@ struct DartFunctionSignature
 	std::vector<FnParam>& Params() { return params; }
 	FnParam& Param(int i) { return params[i]; }
 
-	DartAbstractType* returnType;
+	DartAbstractType* returnType{ nullptr };
 	//typeParams;
 	std::vector<FnParam> params;
-	int numOptionalParam;
-	bool hasNamedParam;
+	int numOptionalParam{ 0 };
+	bool hasNamedParam{ false };
 };
 
 class DartFunction : public DartFnBase
@@ -84,6 +85,11 @@ public:
 
 	void SetAnalyzedData(std::unique_ptr<AnalyzedFnData> data);
 	AnalyzedFnData* GetAnalyzedData() { return analyzedData.get(); }
+	void ReleaseAnalyzedData() { analyzedData.reset(); }
+
+	// Thread/ObjectPool operands from entry point. recorded while analyzing, kept after releasing the analyzed data
+	void SetStructOperands(std::vector<StructOperandRef> refs) { structOperands = std::move(refs); }
+	const std::optional<std::vector<StructOperandRef>>& StructOperands() const { return structOperands; }
 
 	std::string ToCallStatement(const std::vector<std::shared_ptr<VarItem>>& args) const;
 	void PrintHead(std::ostream& of) const;
@@ -108,6 +114,7 @@ private:
 
 	DartFunctionSignature signature;
 	std::unique_ptr<AnalyzedFnData> analyzedData;
+	std::optional<std::vector<StructOperandRef>> structOperands;
 
 	friend class DartApp;
 };
@@ -68,9 +68,19 @@ static Dart_Isolate load_isolate(const uint8_t* isolate_snapshot_data, const uin
 
 Dart_Isolate DartLoader::Load(LibAppInfo& libInfo)
 {
-	init_vm_flags();
-
-	init_dart(libInfo.vm_snapshot_data, libInfo.vm_snapshot_instructions);
+	if (vmLib == nullptr) {
+		if (vmCleanedUp)
+			throw std::runtime_error("Dart VM cannot be initialized again");
+		init_vm_flags();
+		init_dart(libInfo.vm_snapshot_data, libInfo.vm_snapshot_instructions);
+		vmLib = libInfo.lib;
+		vmData = libInfo.vm_snapshot_data;
+		vmInstructions = libInfo.vm_snapshot_instructions;
+	}
+	else if (libInfo.lib != vmLib && memcmp(libInfo.vm_snapshot_data + 20, vmData + 20, 32) != 0) {
+		// VM objects (e.g. stubs) of the first app are used for this app. snapshot hash is after magic, length and kind.
+		throw std::runtime_error("VM snapshot hash is different from the first loaded app");
+	}
 
 	auto isolate = load_isolate(libInfo.isolate_snapshot_data, libInfo.isolate_snapshot_instructions);
 
@@ -80,10 +90,27 @@ Dart_Isolate DartLoader::Load(LibAppInfo& libInfo)
 template<typename T>
 inline void ignore_result(const T& /* unused result */) {}
 
-void DartLoader::Unload()
+void DartLoader::Unload(const LibAppInfo& libInfo)
 {
 	if (Dart_CurrentIsolate() != nullptr) {
 		Dart_ShutdownIsolate();
 	}
+	if (!keepVM) {
+		Cleanup();
+	}
+	else if (libInfo.lib != vmLib) {
+		// only the app of VM snapshot is needed by the VM
+		ElfHelper::UnmapLibAppSo(libInfo);
+	}
+}
+
+void DartLoader::Cleanup()
+{
+	if (vmLib == nullptr)
+		return;
 	ignore_result(Dart_Cleanup());
+	vmLib = nullptr;
+	vmData = nullptr;
+	vmInstructions = nullptr;
+	vmCleanedUp = true;
 }
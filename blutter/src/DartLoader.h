@@ -16,10 +16,27 @@ public:
 		uint32_t offset(intptr_t addr) { return (uint32_t)(addr - base()); }
 	};*/
 
+	// the VM is initialized with VM snapshot of the first loaded app. later apps must be same Dart version.
 	static Dart_Isolate Load(LibAppInfo& libInfo);
-	static void Unload();
+	// shutdown the isolate of the app. the VM is cleaned up too if it is not kept.
+	static void Unload(const LibAppInfo& libInfo);
+
+	// for loading many apps in one process. Dart VM can be initialized only once per process.
+	static void SetKeepVM(bool keep) { keepVM = keep; }
+	// clean up the kept VM. no app can be loaded after this.
+	static void Cleanup();
+
+	// VM snapshot instructions that dart::StubCode is loaded from (the first loaded app)
+	static const uint8_t* VMSnapshotInstructions() { return vmInstructions; }
 
 private:
 	DartLoader() = delete;
+
+	static inline bool keepVM{ false };
+	// the app that the VM snapshot is from. it must be mapped until the VM is cleaned up.
+	static inline const void* vmLib{ nullptr };
+	static inline const uint8_t* vmData{ nullptr };
+	static inline const uint8_t* vmInstructions{ nullptr };
+	static inline bool vmCleanedUp{ false };
 };
 
@@ -1,2 +1,24 @@
 #include "pch.h"
 #include "DartStub.h"
+
+const char* DartStub::KindName(Kind kind)
+{
+	static const char* names[] = {
+#define DO(member, name) #name,
+		OBJECT_STORE_STUB_CODE_LIST(DO)
+#undef DO
+		"BuildNonGenericMethodExtractor",
+		"BuildGenericMethodExtractor",
+#define DO(name) #name,
+		VM_STUB_CODE_LIST(DO)
+#undef DO
+		"Shared",
+		"AllocateUserObject",
+		"TypeCheck",
+		"Unknown",
+	};
+	static_assert(sizeof(names) / sizeof(names[0]) == UnknownStub + 1);
+	if (kind < 0 || kind > UnknownStub)
+		return "Unknown";
+	return names[kind];
+}
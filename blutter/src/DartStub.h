@@ -35,6 +35,9 @@ public:
 	virtual std::string FullName() const { return name + "Stub"; }
 	virtual bool IsStub() const { return true; }
 
+	// name of stub kind without "Stub" suffix
+	static const char* KindName(Kind kind);
+
 	// some stub might contain multiple of duplicated stubs
 	// this functionality is needed only for DartStub (no subclasses)
 	DartStub* Split(uint64_t another_ep_addr) {
@@ -1,8 +1,11 @@
 #include "pch.h"
 #include "DartThreadInfo.h"
+#include <mutex>
 
 static std::unordered_map<intptr_t, std::string> threadOffsetNames;
 static std::unordered_map<intptr_t, LeafFunctionInfo> leafFunctionMap;
+// the maps are read from analysis threads. initialize them only once and never modify after that
+static std::once_flag threadOffsetNamesFlag;
 
 static void initThreadOffsetNames()
 {
@@ -77,15 +80,15 @@ static void initThreadOffsetNames()
 
 const std::string& GetThreadOffsetName(intptr_t offset)
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
-	return threadOffsetNames[offset];
+	static const std::string emptyName;
+	std::call_once(threadOffsetNamesFlag, initThreadOffsetNames);
+	auto it = threadOffsetNames.find(offset);
+	return it == threadOffsetNames.end() ? emptyName : it->second;
 }
 
 intptr_t GetThreadMaxOffset()
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	std::call_once(threadOffsetNamesFlag, initThreadOffsetNames);
 	using pair_type = decltype(threadOffsetNames)::value_type;
 	auto it = std::max_element(threadOffsetNames.begin(), threadOffsetNames.end(), [](const pair_type& o1, const pair_type& o2)
 		{
@@ -96,15 +99,13 @@ intptr_t GetThreadMaxOffset()
 
 const std::unordered_map<intptr_t, std::string>& GetThreadOffsetsMap()
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	std::call_once(threadOffsetNamesFlag, initThreadOffsetNames);
 	return threadOffsetNames;
 }
 
 const LeafFunctionInfo* GetThreadLeafFunction(intptr_t offset)
 {
-	if (threadOffsetNames.empty())
-		initThreadOffsetNames();
+	std::call_once(threadOffsetNamesFlag, initThreadOffsetNames);
 	auto it = leafFunctionMap.find(offset);
 	return it == leafFunctionMap.end() ? nullptr : &it->second;
 }
@@ -1,9 +1,10 @@
 #include "pch.h"
 #include "DartTypes.h"
 #include "DartClass.h"
-#include <numeric>
 #include <sstream>
 
+const std::string DartTypeName::RecursiveName = "...";
+
 const DartTypeArguments DartTypeArguments::Null;
 
 std::string DartTypeArguments::SubvectorName(int from_index, int len) const
@@ -28,7 +29,7 @@ std::string DartTypeArguments::SubvectorName(int from_index, int len) const
 	return txt;
 }
 
-std::string DartType::ToString() const
+std::string DartType::render() const
 {
 	return ToString(true);
 }
@@ -46,7 +47,7 @@ std::string DartType::ToString(bool showTypeArgs) const
 }
 
 #ifdef HAS_RECORD_TYPE
-std::string DartRecordType::ToString() const
+std::string DartRecordType::render() const
 {
 	std::string txt = "(";
 	const intptr_t num_positional_fields = fieldTypes.size() - fieldNames.size();
@@ -74,13 +75,13 @@ std::string DartRecordType::ToString() const
 #endif
 
 #ifdef HAS_TYPE_REF
-std::string DartTypeRef::ToString() const
+std::string DartTypeRef::render() const
 {
 	return type.ToString(false);
 }
 #endif
 
-std::string DartTypeParameter::ToString() const
+std::string DartTypeParameter::render() const
 {
 	// CanonicalName might not start from 0
 	std::string txt;
@@ -103,7 +104,7 @@ std::string DartTypeParameter::ToString() const
 	return txt;
 }
 
-std::string DartFunctionType::ToString() const
+std::string DartFunctionType::render() const
 {
 	std::string txt;
 	if (IsNullable()) {
@@ -112,42 +113,34 @@ std::string DartFunctionType::ToString() const
 
 	if (!typeParams.empty()) {
 		txt += "<";
-		txt += std::accumulate(typeParams.begin() + 1, typeParams.end(), typeParams.front()->ToString(),
-			[](std::string x, const DartTypeParameter* y) {
-				return x + ", " + y->ToString();
-			}
-		);
+		for (size_t i = 0; i < typeParams.size(); i++) {
+			if (i != 0)
+				txt += ", ";
+			txt += typeParams[i]->ToString();
+		}
 		txt += ">";
 	}
 
 	txt += "("; // open for function arguments
-	if (!params.empty()) {
-		auto first = params[0].type->ToString();
-		if (hasImplicitParam)
-			first += " this";
-		txt += std::accumulate(params.begin() + 1, params.end(), first,
-			[](std::string x, const Parameter& y) {
-				return x + ", " + y.type->ToString();
-			}
-		);
+	for (size_t i = 0; i < params.size(); i++) {
+		if (i != 0)
+			txt += ", ";
+		txt += params[i].type->ToString();
+		if (i == 0 && hasImplicitParam)
+			txt += " this";
 	}
 	if (!optionalParams.empty()) {
 		if (!params.empty()) {
 			txt += ", ";
 		}
-		if (hasNamedParam) {
-			txt += std::accumulate(optionalParams.begin() + 1, optionalParams.end(), optionalParams[0].type->ToString() + " " + optionalParams[0].name,
-				[](std::string x, const Parameter& y) {
-					return x + ", " + y.type->ToString() + " " + y.name;
-				}
-			);
-		}
-		else {
-			txt += std::accumulate(optionalParams.begin() + 1, optionalParams.end(), optionalParams[0].type->ToString(),
-				[](std::string x, const Parameter& y) {
-					return x + ", " + y.type->ToString();
-				}
-			);
+		for (size_t i = 0; i < optionalParams.size(); i++) {
+			if (i != 0)
+				txt += ", ";
+			txt += optionalParams[i].type->ToString();
+			if (hasNamedParam) {
+				txt += ' ';
+				txt += optionalParams[i].name;
+			}
 		}
 	}
 	txt += ") => " + resultType->ToString(); // close for function arguments and return type
@@ -159,6 +152,7 @@ std::string DartFunctionType::ToString() const
 
 DartType* DartTypeDb::FindOrAdd(dart::TypePtr typePtr)
 {
+	std::lock_guard lock(mutex);
 	auto ptr = (intptr_t)typePtr;
 	if (typesMap.contains(ptr)) {
 		return typesMap[ptr]->AsType();
@@ -169,7 +163,7 @@ DartType* DartTypeDb::FindOrAdd(dart::TypePtr typePtr)
 	auto dartCls = classes[type.type_class_id()];
 	ASSERT(dartCls);
 	// Add it to DB first. the type arguments might be many recursive calls
-	auto dartType = new DartType(type.IsNullable(), *dartCls, &DartTypeArguments::Null);
+	auto dartType = arena.New<DartType>(type.IsNullable(), *dartCls, &DartTypeArguments::Null);
 	typesMap[ptr] = dartType;
 
 	dartType->args = FindOrAdd(type.arguments());
@@ -188,6 +182,7 @@ DartType* DartTypeDb::FindOrAdd(dart::TypePtr typePtr)
 #ifdef HAS_RECORD_TYPE
 DartRecordType* DartTypeDb::FindOrAdd(dart::RecordTypePtr recordTypePtr)
 {
+	std::lock_guard lock(mutex);
 	auto ptr = (intptr_t)recordTypePtr;
 	if (typesMap.contains(ptr)) {
 		return typesMap[ptr]->AsRecordType();
@@ -206,7 +201,7 @@ DartRecordType* DartTypeDb::FindOrAdd(dart::RecordTypePtr recordTypePtr)
 		fieldNames.push_back(name.ToCString());
 	}
 
-	auto dartRecordType = new DartRecordType(recordType.IsNullable(), std::move(fieldNames));
+	auto dartRecordType = arena.New<DartRecordType>(recordType.IsNullable(), std::move(fieldNames));
 	typesMap[ptr] = dartRecordType;
 
 	const auto num_fields = recordType.NumFields();
@@ -221,6 +216,7 @@ DartRecordType* DartTypeDb::FindOrAdd(dart::RecordTypePtr recordTypePtr)
 
 DartTypeParameter* DartTypeDb::FindOrAdd(dart::TypeParameterPtr typeParamPtr)
 {
+	std::lock_guard lock(mutex);
 	auto ptr = (intptr_t)typeParamPtr;
 	if (typesMap.contains(ptr)) {
 		return typesMap[ptr]->AsTypeParameter();
@@ -228,7 +224,7 @@ DartTypeParameter* DartTypeDb::FindOrAdd(dart::TypeParameterPtr typeParamPtr)
 
 	const auto& typeParam = dart::TypeParameter::Handle(typeParamPtr);
 	// Add it to DB first. the bound might be many recursive calls
-	auto dartTypeParam = new DartTypeParameter(typeParam.IsNullable(), (uint16_t)typeParam.base(), (uint16_t)typeParam.index(), typeParam.IsClassTypeParameter());
+	auto dartTypeParam = arena.New<DartTypeParameter>(typeParam.IsNullable(), (uint16_t)typeParam.base(), (uint16_t)typeParam.index(), typeParam.IsClassTypeParameter());
 	typesMap[ptr] = dartTypeParam;
 
 	// Removing TypeRef also replaces TypeParameter.bound with TypeParameter.owner
@@ -249,6 +245,7 @@ DartTypeParameter* DartTypeDb::FindOrAdd(dart::TypeParameterPtr typeParamPtr)
 
 DartFunctionType* DartTypeDb::FindOrAdd(dart::FunctionTypePtr fnTypePtr)
 {
+	std::lock_guard lock(mutex);
 	auto ptr = (intptr_t)fnTypePtr;
 	if (typesMap.contains(ptr)) {
 		return typesMap[ptr]->AsFunctionType();
@@ -265,7 +262,7 @@ DartFunctionType* DartTypeDb::FindOrAdd(dart::FunctionTypePtr fnTypePtr)
 		const intptr_t base = fnType.NumParentTypeArguments();
 		const bool kIsClassTypeParameter = false;
 		for (intptr_t i = 0; i < num_type_params; i++) {
-			auto dartTypeParam = new DartTypeParameter(false, (uint16_t)base, (uint16_t)(base + i), kIsClassTypeParameter);
+			auto dartTypeParam = arena.New<DartTypeParameter>(false, (uint16_t)base, (uint16_t)(base + i), kIsClassTypeParameter);
 			dartTypeParam->bound = FindOrAdd(type_params.BoundAt(i));
 			// Note: there might be defaults to
 
@@ -274,7 +271,7 @@ DartFunctionType* DartTypeDb::FindOrAdd(dart::FunctionTypePtr fnTypePtr)
 	}
 
 	// Add it to DB first. the bound might be many recursive calls
-	auto dartFnType = new DartFunctionType(fnType.IsNullable(), fnType.num_implicit_parameters() != 0, fnType.HasOptionalNamedParameters(), std::move(typeParams));
+	auto dartFnType = arena.New<DartFunctionType>(fnType.IsNullable(), fnType.num_implicit_parameters() != 0, fnType.HasOptionalNamedParameters(), std::move(typeParams));
 	typesMap[ptr] = dartFnType;
 
 	dartFnType->resultType = FindOrAdd(fnType.result_type());
@@ -307,6 +304,7 @@ DartFunctionType* DartTypeDb::FindOrAdd(dart::FunctionTypePtr fnTypePtr)
 
 DartAbstractType* DartTypeDb::FindOrAdd(dart::AbstractTypePtr abTypePtr)
 {
+	std::lock_guard lock(mutex);
 	switch (abTypePtr.GetClassId()) {
 	case dart::kTypeCid:
 		return FindOrAdd(dart::Type::RawCast(abTypePtr));
@@ -318,7 +316,7 @@ DartAbstractType* DartTypeDb::FindOrAdd(dart::AbstractTypePtr abTypePtr)
 	case dart::kTypeRefCid: {
 		auto typePtr = dart::TypeRef::RawCast(abTypePtr)->untag()->type();
 		ASSERT(typePtr.GetClassId() == dart::kTypeCid);
-		return new DartTypeRef(*FindOrAdd(dart::Type::RawCast(typePtr)));
+		return arena.New<DartTypeRef>(*FindOrAdd(dart::Type::RawCast(typePtr)));
 	}
 #endif
 	case dart::kTypeParameterCid:
@@ -332,6 +330,7 @@ DartAbstractType* DartTypeDb::FindOrAdd(dart::AbstractTypePtr abTypePtr)
 
 const DartTypeArguments* DartTypeDb::FindOrAdd(dart::TypeArgumentsPtr typeArgsPtr)
 {
+	std::lock_guard lock(mutex);
 	if ((intptr_t)typeArgsPtr == (intptr_t)dart::Object::null()) {
 		return &DartTypeArguments::Null;
 	}
@@ -346,7 +345,7 @@ const DartTypeArguments* DartTypeDb::FindOrAdd(dart::TypeArgumentsPtr typeArgsPt
 	std::vector<DartAbstractType*> args(typeArgsLen);
 
 	// Add it to DB first. the bound might be many recursive calls
-	auto dartTypeArgs = new DartTypeArguments(std::move(args));
+	auto dartTypeArgs = arena.New<DartTypeArguments>(std::move(args));
 	typeArgsMap[ptr] = dartTypeArgs;
 
 	for (auto i = 0; i < typeArgsLen; i++) {
@@ -359,6 +358,7 @@ const DartTypeArguments* DartTypeDb::FindOrAdd(dart::TypeArgumentsPtr typeArgsPt
 
 DartType* DartTypeDb::FindOrAdd(DartClass& dartCls, const dart::TypeArgumentsPtr typeArgsPtr)
 {
+	std::lock_guard lock(mutex);
 	auto args = FindOrAdd(typeArgsPtr);
 	auto& types = typesByCid[dartCls.Id()];
 	// we want to find same type args
@@ -368,7 +368,7 @@ DartType* DartTypeDb::FindOrAdd(DartClass& dartCls, const dart::TypeArgumentsPtr
 		return dtype->args == args;
 	});
 	if (it == types.end()) {
-		dartType = new DartType{ false, dartCls, args };
+		dartType = arena.New<DartType>(false, dartCls, args);
 		types.push_back(dartType);
 	}
 	else {
@@ -380,6 +380,7 @@ DartType* DartTypeDb::FindOrAdd(DartClass& dartCls, const dart::TypeArgumentsPtr
 
 DartType* DartTypeDb::FindOrAdd(DartClass& dartCls, const dart::Instance& inst)
 {
+	std::lock_guard lock(mutex);
 	if (dartCls.NumTypeParameters() == 0) {
 		// this class cannot be parameterized
 		return dartCls.DeclarationType();
@@ -392,11 +393,12 @@ DartType* DartTypeDb::FindOrAdd(DartClass& dartCls, const dart::Instance& inst)
 
 DartType* DartTypeDb::FindOrAdd(uint32_t cid, const DartTypeArguments* typeArgs)
 {
+	std::lock_guard lock(mutex);
 	for (auto type : typesByCid[cid]) {
 		if (type->args == typeArgs)
 			return type;
 	}
-	auto dartType = new DartType{ false, *classes[cid], typeArgs };
+	auto dartType = arena.New<DartType>(false, *classes[cid], typeArgs);
 	typesByCid[cid].push_back(dartType);
 	return dartType;
 }
@@ -1,4 +1,7 @@
 #pragma once
+#include "Arena.h"
+#include <atomic>
+#include <mutex>
 
 // forward declaration
 class DartClass;
@@ -15,6 +18,52 @@ class DartTypeParameter;
 class DartFunctionType;
 class DartTypeDb;
 
+// Rendered name of a type or type arguments. A type in DartTypeDb is never modified after FindOrAdd() returns,
+// so the name is rendered only once and the reference is valid as long as the type.
+class DartTypeName {
+public:
+	DartTypeName() = default;
+	DartTypeName(const DartTypeName&) = delete;
+	DartTypeName(DartTypeName&&) = delete;
+	DartTypeName& operator=(const DartTypeName&) = delete;
+
+	template <typename F>
+	const std::string& Get(F&& render) const {
+		if (state.load(std::memory_order_acquire) == Ready)
+			return name;
+		std::lock_guard lock(renderMutex);
+		switch (state.load(std::memory_order_relaxed)) {
+		case Ready:
+			return name;
+		case Rendering:
+			// the type contains itself. the outer render is on this thread (the lock is reentrant)
+			return RecursiveName;
+		default:
+			break;
+		}
+		state.store(Rendering, std::memory_order_relaxed);
+		auto txt = render();
+		name = std::move(txt);
+		state.store(Ready, std::memory_order_release);
+		return name;
+	}
+
+	static const std::string RecursiveName;
+
+private:
+	enum State : uint8_t {
+		Empty,
+		Rendering,
+		Ready,
+	};
+
+	mutable std::atomic<uint8_t> state{ Empty };
+	mutable std::string name;
+
+	// rendering a name renders its children. one lock for all names is enough because a name is rendered only once.
+	static inline std::recursive_mutex renderMutex;
+};
+
 class DartAbstractType {
 public:
 	enum Kind : uint8_t {
@@ -33,8 +82,10 @@ public:
 	DartAbstractType() = delete;
 
 	bool IsNullable() const { return nullable; }
+	Kind GetKind() const { return kind; }
 
-	virtual std::string ToString() const = 0;
+	// the name is rendered on first call then cached
+	const std::string& ToString() const { return cachedName.Get([this] { return render(); }); }
 
 	bool IsType() const { return kind == Kind::Type; }
 	bool IsTypeParameter() const { return kind == Kind::TypeParam; }
@@ -65,8 +116,11 @@ public:
 	}
 
 protected:
+	virtual std::string render() const = 0;
+
 	Kind kind;
 	bool nullable;
+	DartTypeName cachedName;
 };
 
 class DartTypeArguments {
@@ -75,13 +129,16 @@ public:
 	explicit DartTypeArguments() {}
 
 	std::string SubvectorName(int from_index, int len) const;
-	std::string ToString() const { return args.empty() ? std::string() : SubvectorName(0, (int)args.size()); }
+	const std::string& ToString() const {
+		return cachedName.Get([this] { return args.empty() ? std::string() : SubvectorName(0, (int)args.size()); });
+	}
 	size_t Length() const { return args.size(); }
 
 	static const DartTypeArguments Null;
 
 protected:
 	std::vector<DartAbstractType*> args;
+	DartTypeName cachedName;
 
 	friend class DartTypeDb;
 };
@@ -93,10 +150,12 @@ public:
 	const DartTypeArguments& Arguments() const { return *args; }
 	const DartClass& Class() const { return cls; }
 
-	virtual std::string ToString() const;
+	using DartAbstractType::ToString;
 	std::string ToString(bool showTypeArgs) const;
 
 protected:
+	virtual std::string render() const;
+
 	explicit DartType(bool nullable, DartClass& cls, const DartTypeArguments* args) : DartAbstractType(Kind::Type, nullable), cls(cls), args(args) {}
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	//explicit DartType(bool nullable, DartClass& cls) : DartAbstractType(Kind::Type, nullable), cls(cls), args(nullptr) {}
@@ -106,6 +165,7 @@ protected:
 
 	friend class DartTypeDb;
 	friend class DartApp;
+	friend class Arena;
 };
 
 #ifdef HAS_RECORD_TYPE
@@ -114,9 +174,9 @@ class DartRecordType : public DartAbstractType
 public:
 	DartRecordType() = delete;
 
-	virtual std::string ToString() const;
-
 protected:
+	virtual std::string render() const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartRecordType(bool nullable, std::vector<std::string> fieldNames) : DartAbstractType(Kind::RecordType, nullable), fieldNames(std::move(fieldNames)) {}
 
@@ -124,6 +184,7 @@ protected:
 	std::vector<std::string> fieldNames;
 
 	friend class DartTypeDb;
+	friend class Arena;
 };
 #endif
 
@@ -133,15 +194,16 @@ class DartTypeRef : public DartAbstractType
 public:
 	DartTypeRef() = delete;
 
-	virtual std::string ToString() const;
-
 protected:
+	virtual std::string render() const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartTypeRef(DartType& type) : DartAbstractType(Kind::TypeRef, false), type(type) {}
 
 	DartType& type;
 
 	friend class DartTypeDb;
+	friend class Arena;
 };
 #endif
 
@@ -149,9 +211,9 @@ class DartTypeParameter : public DartAbstractType {
 public:
 	DartTypeParameter() = delete;
 
-	virtual std::string ToString() const;
-
 protected:
+	virtual std::string render() const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartTypeParameter(bool nullable, uint16_t base, uint16_t index, bool isClassTypeParam)
 		: DartAbstractType(Kind::TypeParam, nullable), base(base), index(index), isClassTypeParam(isClassTypeParam), bound(nullptr) {}
@@ -163,14 +225,13 @@ protected:
 	DartAbstractType* bound;
 
 	friend class DartTypeDb;
+	friend class Arena;
 };
 
 class DartFunctionType : public DartAbstractType {
 public:
 	DartFunctionType() = delete;
 
-	virtual std::string ToString() const;
-
 	// Note: positional parameter names are removed in AOT
 	struct Parameter {
 		Parameter(std::string name, DartAbstractType* type) : name(std::move(name)), type(type) {}
@@ -186,6 +247,8 @@ public:
 	};
 
 protected:
+	virtual std::string render() const;
+
 	// incomplete initialization. we need it to prevent infinite loop when creating a new type
 	explicit DartFunctionType(bool nullable, bool hasImplicitParam, bool hasNamedParam, std::vector<DartTypeParameter*> typeParams)
 		: DartAbstractType(Kind::FunctionType, nullable), hasImplicitParam(hasImplicitParam), hasNamedParam(hasNamedParam), resultType(nullptr), typeParams(std::move(typeParams)) {}
@@ -202,6 +265,7 @@ protected:
 	std::vector<OptionalParameter> optionalParams; // function parameters in "[]" or "{}"
 
 	friend class DartTypeDb;
+	friend class Arena;
 };
 
 class DartTypeDb {
@@ -236,5 +300,13 @@ protected:
 
 	std::vector<DartClass*>& classes;
 
+	// all types and type arguments are allocated here. they are freed together with the db.
+	Arena arena{ 64 * 1024 };
+
+	// types are added lazily while analyzing functions in multiple threads.
+	// FindOrAdd() is recursive so the lock must be reentrant.
+	std::recursive_mutex mutex;
+
 	friend class DartApp;
+	friend class ModelExporter;
 };
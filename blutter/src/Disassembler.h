@@ -95,3 +95,23 @@ private:
 	csh cshandle;
 };
 
+// an instruction operand that refers to Dart Thread or ObjectPool register. used for applying struct offset in IDA
+struct StructOperandRef {
+	enum Base : uint8_t {
+		Thread,
+		ObjectPool,
+	};
+
+	uint32_t offset; // instruction offset from the first disassembled instruction
+	uint8_t opIdx;
+	Base base;
+};
+
+// find the first Thread or ObjectPool operand of each instruction (instructions must have detail)
+// implementation is specific to architecture
+std::vector<StructOperandRef> FindStructOperands(AsmInstructions& insns);
+
+// render an instruction as mnemonic (padded to 16 characters) and operands with Dart register names (instruction does not need detail)
+// implementation is specific to architecture
+void RenderAsmText(const cs_insn* insn, std::string& text);
+
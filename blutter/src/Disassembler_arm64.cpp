@@ -15,12 +15,15 @@ const char* Register::RegisterNames[] = {
 }
 
 // singleton of capstone handle. use for global resolve register name  of aarch64
-static csh g_cshandle;
+// static local initialization is thread safe. this function is called from analysis threads.
 const char* GetCsRegisterName(arm64_reg reg)
 {
-	if (g_cshandle == 0)
-		cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, &g_cshandle);
-	return cs_reg_name(g_cshandle, reg);
+	static const csh cshandle = [] {
+		csh handle = 0;
+		cs_open(CS_ARCH_ARM64, CS_MODE_LITTLE_ENDIAN, &handle);
+		return handle;
+	}();
+	return cs_reg_name(cshandle, reg);
 }
 
 Disassembler::Disassembler(bool hasDetail)
@@ -31,3 +34,71 @@ Disassembler::Disassembler(bool hasDetail)
 	if (hasDetail)
 		cs_option(cshandle, CS_OPT_DETAIL, CS_OPT_ON);
 }
+
+std::vector<StructOperandRef> FindStructOperands(AsmInstructions& insns)
+{
+	std::vector<StructOperandRef> refs;
+	if (insns.Count() == 0)
+		return refs;
+
+	const auto first_addr = insns.FirstPtr()->address;
+	for (size_t i = 0; i < insns.Count(); i++) {
+		auto insn = insns.Ptr(i);
+		const auto& detail = insn->detail->arm64;
+		for (uint8_t j = 0; j < detail.op_count; j++) {
+			auto reg = ARM64_REG_INVALID;
+			if (detail.operands[j].type == ARM64_OP_REG)
+				reg = detail.operands[j].reg;
+			else if (detail.operands[j].type == ARM64_OP_MEM)
+				reg = detail.operands[j].mem.base;
+			if (reg == CSREG_DART_THR) {
+				refs.push_back(StructOperandRef{ (uint32_t)(insn->address - first_addr), j, StructOperandRef::Thread });
+				break;
+			}
+			else if (reg == CSREG_DART_PP) {
+				// TODO: if it is not MEM operand, reg cannot be struct offset
+				refs.push_back(StructOperandRef{ (uint32_t)(insn->address - first_addr), j, StructOperandRef::ObjectPool });
+				break;
+			}
+		}
+	}
+	return refs;
+}
+
+void RenderAsmText(const cs_insn* insn, std::string& text)
+{
+	text.assign(insn->mnemonic);
+	if (text.size() < 16)
+		text.resize(16, ' ');
+
+	// convert register name in op_str
+	auto op_ptr = insn->op_str;
+	bool token_start = true;
+	while (*op_ptr != '\0') {
+		if (token_start && (op_ptr[0] == 'x' || op_ptr[0] == 'w')) {
+			const char* name = nullptr;
+			if (op_ptr[1] == '1' && op_ptr[2] == '5')
+				name = "SP";
+			else if (op_ptr[1] == '2' && op_ptr[2] == '2')
+				name = "NULL";
+			else if (op_ptr[1] == '2' && op_ptr[2] == '6')
+				name = "THR";
+			else if (op_ptr[1] == '2' && op_ptr[2] == '7')
+				name = "PP";
+			else if (op_ptr[1] == '2' && op_ptr[2] == '8')
+				name = "HEAP";
+			else if (op_ptr[1] == '2' && op_ptr[2] == '9')
+				name = "fp";
+			else if (op_ptr[1] == '3' && op_ptr[2] == '0')
+				name = "lr";
+
+			if (name) {
+				text += name;
+				op_ptr += 3;
+				continue;
+			}
+		}
+		token_start = *op_ptr == ' ' || *op_ptr == '[';
+		text += *op_ptr++;
+	}
+}
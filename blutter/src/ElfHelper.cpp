@@ -13,7 +13,10 @@ PRAGMA_WARNING(pop)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #else
+#include <cerrno>
+#include <cstring>
 #include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
 //#include <dlfcn.h>
 #include <sys/mman.h>
@@ -31,44 +34,209 @@ struct ElfIdent {
 
 using namespace dart::elf;
 
+// throws if the file is not a little endian 64 bits ELF
+[[maybe_unused]] static void check_elf_ident(const uint8_t* file)
+{
+	const auto* ident = (const ElfIdent*)((const ElfHeader*)file)->ident;
+	if (memcmp(ident->ei_magic, "\x7f" "ELF", 4) != 0)
+		throw std::invalid_argument("ELF: Invalid magic header"); // need ELF file
+	if (ident->ei_data != 1)
+		throw std::invalid_argument("ELF: Support only little endian"); // expect little-endian
+
+	if (ident->ei_class != ELFCLASS64) { // 1 is 32 bits, 2 is 64 bits
+		throw std::invalid_argument("ELF: Support only 64 bits"); // support only 64 bits
+	}
+	// expected e_machine
+	//   3: x86, 0x28: ARM
+	//   0x3e: x86-64, 0xB7: Aarch64
+	// EM_386, EM_ARM, EM_X86_64, EM_AARCH64
+	//hdr->e_machine;
+}
+
+// fileView is the file content for parsing ELF headers and sections. release it with unmap_file_view().
+// the returned memory is the loaded libapp. it might be same as fileView.
 #ifdef _WIN32
-static void* load_map_file(const char* path)
+static void* load_map_file(const char* path, size_t& size, const uint8_t*& fileView, size_t& fileSize)
 {
-	HANDLE hFile = CreateFileA(path, GENERIC_READ, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-	if (hFile == INVALID_HANDLE_VALUE) {
-		printf("\nCannot find %s\n", path);
-		return NULL;
+	HANDLE hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(std::format("Cannot open {}: error {}", path, GetLastError()));
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize)) {
+		CloseHandle(hFile);
+		throw std::runtime_error(std::format("Cannot get size of {}: error {}", path, GetLastError()));
 	}
+	size = (size_t)fileSize.QuadPart;
 
 	// because Dart API requires only snapshot buffer addresses (no relative access across snapshot),
 	//   so we can just mapping a whole file and find address of snapshots
+	// Note: a view must start at allocation granularity (64KB). mapping each segment is not possible for most libapp.
 	HANDLE hMapFile = CreateFileMapping(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
-	if (hMapFile == INVALID_HANDLE_VALUE)
-		return NULL;
+	CloseHandle(hFile);
+	if (hMapFile == NULL)
+		throw std::runtime_error(std::format("Cannot map {}: error {}", path, GetLastError()));
 
 	// need RW because dart initialization need writing data in BSS
 	void* mem = MapViewOfFile(hMapFile, FILE_MAP_COPY, 0, 0, 0);
 	CloseHandle(hMapFile);
-
-	CloseHandle(hFile);
+	if (mem == NULL)
+		throw std::runtime_error(std::format("Cannot map {}: error {}", path, GetLastError()));
+	fileView = (const uint8_t*)mem;
+	fileSize = size;
 	return mem;
 }
+
+static void unmap_file_view(const uint8_t*, size_t)
+{
+}
 #else
-static void* load_map_file(const char* path)
+// standard ELF values
+constexpr uint32_t kElfPtLoad = 1;
+constexpr uint32_t kElfPfX = 1;
+constexpr uint32_t kElfPfW = 2;
+
+static std::runtime_error sysError(const char* what, const char* path)
+{
+	return std::runtime_error(std::format("{} {}: {}", what, path, strerror(errno)));
+}
+
+// map PT_LOAD segments at their virtual addresses like a dynamic loader. only writable segments (BSS) are copy-on-write.
+// returns nullptr if the segments cannot be mapped with the host page size.
+static uint8_t* map_load_segments(int fd, const char* path, const uint8_t* file, size_t fileSize, size_t& size)
+{
+	const auto* hdr = (const ElfHeader*)file;
+	if (hdr->program_table_entry_size != sizeof(ProgramHeader) ||
+		hdr->program_table_offset + hdr->num_program_headers * sizeof(ProgramHeader) > fileSize)
+	{
+		throw std::invalid_argument("ELF: Invalid program header table");
+	}
+	const auto* phdrs = (const ProgramHeader*)(file + hdr->program_table_offset);
+	const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+	auto pageFloor = [pageSize](uint64_t v) { return v & ~(pageSize - 1); };
+	auto pageCeil = [pageSize](uint64_t v) { return (v + pageSize - 1) & ~(pageSize - 1); };
+
+	uint64_t span = 0;
+	for (uint16_t i = 0; i < hdr->num_program_headers; i++) {
+		const auto& phdr = phdrs[i];
+		if ((uint32_t)phdr.type != kElfPtLoad)
+			continue;
+		if (phdr.file_offset + phdr.file_size > fileSize)
+			throw std::invalid_argument("ELF: Segment is out of file");
+		if (phdr.file_offset % pageSize != phdr.memory_offset % pageSize)
+			return nullptr;
+		span = std::max<uint64_t>(span, phdr.memory_offset + phdr.memory_size);
+	}
+	if (span == 0)
+		return nullptr;
+	span = pageCeil(span);
+
+	// reserve whole address range first, so segments keep their relative addresses
+	auto base = (uint8_t*)mmap(NULL, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		throw sysError("Cannot reserve memory for", path);
+
+	for (uint16_t i = 0; i < hdr->num_program_headers; i++) {
+		const auto& phdr = phdrs[i];
+		if ((uint32_t)phdr.type != kElfPtLoad)
+			continue;
+		// the app code is never executed. it is only read by the VM and the disassembler.
+		const int prot = (phdr.flags & kElfPfW) ? PROT_READ | PROT_WRITE : PROT_READ;
+		const auto pageStart = pageFloor(phdr.memory_offset);
+		const auto pageDelta = phdr.memory_offset - pageStart;
+		if (phdr.file_size > 0) {
+			if (mmap(base + pageStart, phdr.file_size + pageDelta, prot, MAP_PRIVATE | MAP_FIXED, fd, phdr.file_offset - pageDelta) == MAP_FAILED) {
+				munmap(base, span);
+				throw sysError("Cannot map segment of", path);
+			}
+		}
+
+		const auto fileEnd = phdr.memory_offset + phdr.file_size;
+		const auto memEnd = phdr.memory_offset + phdr.memory_size;
+		if (memEnd > fileEnd) {
+			// BSS. zero the rest of the last file page, then use anonymous pages.
+			const auto anonStart = phdr.file_size > 0 ? pageCeil(fileEnd) : pageStart;
+			if (phdr.file_size > 0 && (prot & PROT_WRITE))
+				memset(base + fileEnd, 0, std::min(anonStart, memEnd) - fileEnd);
+			if (pageCeil(memEnd) > anonStart) {
+				if (mmap(base + anonStart, pageCeil(memEnd) - anonStart, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+					munmap(base, span);
+					throw sysError("Cannot map BSS of", path);
+				}
+			}
+		}
+		else if (!(phdr.flags & kElfPfX)) {
+			// snapshot data is read from start to end while the VM is loading the heap
+			madvise(base + pageStart, pageCeil(fileEnd) - pageStart, MADV_SEQUENTIAL);
+		}
+	}
+
+	size = span;
+	return base;
+}
+
+static void* load_map_file(const char* path, size_t& size, const uint8_t*& fileView, size_t& fileSize)
 {
-	// need RW because dart initialization need writing data in BSS
 	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		throw sysError("Cannot open", path);
 	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw sysError("Cannot stat", path);
+	}
+	fileSize = st.st_size;
+	if (fileSize < sizeof(ElfHeader)) {
+		close(fd);
+		throw std::invalid_argument("ELF: File is too small");
+	}
+
+	// read only view of the file for parsing headers. only touched pages are read.
+	auto file = (const uint8_t*)mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (file == MAP_FAILED) {
+		close(fd);
+		throw sysError("Cannot map", path);
+	}
+
+	void* mem = nullptr;
+	try {
+#if !defined(DART_TARGET_OS_MACOS)
+		// reject a bad file before mapping it for the VM
+		check_elf_ident(file);
+		mem = map_load_segments(fd, path, file, fileSize, size);
+#endif
+	}
+	catch (...) {
+		munmap((void*)file, fileSize);
+		close(fd);
+		throw;
+	}
 
-	fstat(fd, &st);
-	void* mem = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (mem == nullptr) {
+		// segments are not aligned to host page. fallback to mapping whole file.
+		// need RW because dart initialization need writing data in BSS
+		munmap((void*)file, fileSize);
+		mem = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (mem == MAP_FAILED) {
+			close(fd);
+			throw sysError("Cannot map", path);
+		}
+		file = (const uint8_t*)mem;
+		size = fileSize;
+	}
 
 	close(fd);
+	fileView = file;
 	return mem;
 }
+
+static void unmap_file_view(const uint8_t* fileView, size_t fileSize)
+{
+	munmap((void*)fileView, fileSize);
+}
 #endif
 
-LibAppInfo ElfHelper::findSnapshots(const uint8_t* elf)
+LibAppInfo ElfHelper::findSnapshots(const uint8_t* elf, const uint8_t* base)
 {
 	const auto* hdr = (const ElfHeader*)elf;
 	if (hdr->section_table_entry_size != sizeof(SectionHeader))
@@ -116,16 +284,16 @@ LibAppInfo ElfHelper::findSnapshots(const uint8_t* elf)
 		const char* name = dynstr + dynsym->name;
 		// Note: sym_size is no needed for dart VM (its blob contains size)
 		if (strcmp(name, kVmSnapshotDataAsmSymbol) == 0) {
-			vm_snapshot_data = elf + dynsym->value;
+			vm_snapshot_data = base + dynsym->value;
 		}
 		else if (strcmp(name, kVmSnapshotInstructionsAsmSymbol) == 0) {
-			vm_snapshot_instructions = elf + dynsym->value;
+			vm_snapshot_instructions = base + dynsym->value;
 		}
 		else if (strcmp(name, kIsolateSnapshotDataAsmSymbol) == 0) {
-			isolate_snapshot_data = elf + dynsym->value;
+			isolate_snapshot_data = base + dynsym->value;
 		}
 		else if (strcmp(name, kIsolateSnapshotInstructionsAsmSymbol) == 0) {
-			isolate_snapshot_instructions = elf + dynsym->value;
+			isolate_snapshot_instructions = base + dynsym->value;
 		}
 	}
 
@@ -139,7 +307,7 @@ LibAppInfo ElfHelper::findSnapshots(const uint8_t* elf)
 		throw std::invalid_argument("ELF: Cannot find Dart Isolate Snapshot Instructions");
 
 	return LibAppInfo{
-		.lib = elf,
+		.lib = base,
 		.vm_snapshot_data = vm_snapshot_data,
 		.vm_snapshot_instructions = vm_snapshot_instructions,
 		.isolate_snapshot_data = isolate_snapshot_data,
@@ -149,9 +317,27 @@ LibAppInfo ElfHelper::findSnapshots(const uint8_t* elf)
 
 LibAppInfo ElfHelper::MapLibAppSo(const char* path)
 {
-	void* lib = load_map_file(path);
+	size_t size = 0;
+	const uint8_t* fileView = nullptr;
+	size_t fileSize = 0;
+	void* lib = load_map_file(path, size, fileView, fileSize);
+	// unmap everything when the file cannot be used. batch mode continues with next file.
+	struct MappingGuard {
+		void* lib;
+		size_t size;
+		const uint8_t* fileView;
+		size_t fileSize;
+		bool keep{ false };
+		~MappingGuard() {
+			if (keep)
+				return;
+			if (fileView != lib)
+				unmap_file_view(fileView, fileSize);
+			ElfHelper::UnmapLibAppSo(LibAppInfo{ .lib = lib, .size = size });
+		}
+	} guard{ lib, size, fileView, fileSize };
 	// quick and dirty parsing ELF to get symbol addresses
-	uint8_t* elf = (uint8_t*)(lib);
+	const uint8_t* elf = fileView;
 #if defined(DART_TARGET_OS_MACOS)
 	// Note: only new dart version getting snapshots from load command
 	// <=2.17, use EXPORT name
@@ -170,22 +356,28 @@ LibAppInfo ElfHelper::MapLibAppSo(const char* path)
 		throw std::invalid_argument("Mach-O: Invalid magic header");
 	}
 #else
-	const auto* hdr = (ElfHeader*)elf;
-	const auto* ident = (ElfIdent*)hdr->ident;
-	if (memcmp(ident->ei_magic, "\x7f" "ELF", 4) != 0)
-		throw std::invalid_argument("ELF: Invalid magic header"); // need ELF file
-	if (ident->ei_data != 1)
-		throw std::invalid_argument("ELF: Support only little endian"); // expect little-endian
-
-	if (ident->ei_class != ELFCLASS64) { // 1 is 32 bits, 2 is 64 bits
-		throw std::invalid_argument("ELF: Support only 64 bits"); // support only 64 bits
-	}
-	// expected e_machine
-	//   3: x86, 0x28: ARM
-	//   0x3e: x86-64, 0xB7: Aarch64
-	// EM_386, EM_ARM, EM_X86_64, EM_AARCH64
-	//hdr->e_machine;
+#ifdef _WIN32
+	// other platforms check it before mapping
+	if (fileSize < sizeof(ElfHeader))
+		throw std::invalid_argument("ELF: File is too small");
+	check_elf_ident(elf);
 #endif
+#endif
+
+	// section headers might not be in any segment. parse them from the file view.
+	auto libInfo = findSnapshots(elf, (const uint8_t*)lib);
+	guard.keep = true;
+	if (fileView != lib)
+		unmap_file_view(fileView, fileSize);
+	libInfo.size = size;
+	return libInfo;
+}
 
-	return findSnapshots(elf);
+void ElfHelper::UnmapLibAppSo(const LibAppInfo& libInfo)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(libInfo.lib);
+#else
+	munmap((void*)libInfo.lib, libInfo.size);
+#endif
 }
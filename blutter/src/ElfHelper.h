@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <stddef.h>
 
 struct LibAppInfo {
 	const void* lib;
@@ -7,13 +8,16 @@ struct LibAppInfo {
 	const uint8_t* vm_snapshot_instructions;
 	const uint8_t* isolate_snapshot_data;
 	const uint8_t* isolate_snapshot_instructions;
+	size_t size; // mapped size of lib (the range of all PT_LOAD segments or whole file)
 };
 
 class ElfHelper final
 {
 public:
-	static LibAppInfo findSnapshots(const uint8_t* elf);
+	// elf is the file content. snapshot addresses are relative to base (the loaded libapp).
+	static LibAppInfo findSnapshots(const uint8_t* elf, const uint8_t* base);
 	static LibAppInfo MapLibAppSo(const char* path);
+	static void UnmapLibAppSo(const LibAppInfo& libInfo);
 
 private:
 	ElfHelper() = delete;
@@ -0,0 +1,45 @@
+#include "pch.h"
+#include "FnAddressIndex.h"
+
+FnAddressIndex::FnAddressIndex(std::vector<Entry> entries_) : entries(std::move(entries_))
+{
+	// zero size entry is placed before a normal entry at same address, so a lookup always gets the normal one
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+		return a.addr < b.addr || (a.addr == b.addr && a.addrEnd < b.addrEnd);
+	});
+}
+
+const FnAddressIndex::Entry* FnAddressIndex::Find(uint64_t addr) const
+{
+	auto itr = std::upper_bound(entries.begin(), entries.end(), addr, [](uint64_t addr, const Entry& entry) {
+		return addr < entry.addr;
+	});
+	if (itr == entries.begin())
+		return nullptr;
+	--itr;
+	return itr->Contains(addr) ? &*itr : nullptr;
+}
+
+void FnAddressIndex::Find(std::span<const uint64_t> addrs, std::span<const Entry*> results) const
+{
+	ASSERT(addrs.size() == results.size());
+	// search from previous position while the addresses are increasing
+	auto first = entries.begin();
+	uint64_t prevAddr = 0;
+	for (size_t i = 0; i < addrs.size(); i++) {
+		const auto addr = addrs[i];
+		if (addr < prevAddr)
+			first = entries.begin();
+		prevAddr = addr;
+
+		auto itr = std::upper_bound(first, entries.end(), addr, [](uint64_t addr, const Entry& entry) {
+			return addr < entry.addr;
+		});
+		if (itr == entries.begin()) {
+			results[i] = nullptr;
+			continue;
+		}
+		first = itr - 1;
+		results[i] = first->Contains(addr) ? &*first : nullptr;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "DartFnBase.h"
+#include <span>
+#include <vector>
+
+// Sorted address ranges of all functions and stubs for finding a function/stub that contains an address.
+// The index is built once after all functions are loaded and never modified.
+class FnAddressIndex
+{
+public:
+	struct Entry {
+		uint64_t addr;
+		uint64_t addrEnd; // range at the time the index is built (a stub might be split later)
+		DartFnBase* fn;
+
+		bool Contains(uint64_t target) const { return target == addr || (target > addr && target < addrEnd); }
+	};
+
+	FnAddressIndex() = default;
+	explicit FnAddressIndex(std::vector<Entry> entries);
+	FnAddressIndex(const FnAddressIndex&) = delete;
+	FnAddressIndex(FnAddressIndex&&) = default;
+	FnAddressIndex& operator=(const FnAddressIndex&) = delete;
+	FnAddressIndex& operator=(FnAddressIndex&&) = default;
+
+	// the entry that contains addr. nullptr if there is no function or stub at addr.
+	const Entry* Find(uint64_t addr) const;
+	// find entries of many addresses at once. it is faster when the addresses are sorted.
+	void Find(std::span<const uint64_t> addrs, std::span<const Entry*> results) const;
+
+	const std::vector<Entry>& Entries() const { return entries; }
+	size_t Size() const { return entries.size(); }
+
+private:
+	std::vector<Entry> entries;
+};
@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "FridaWriter.h"
-#include <fstream>
 #include <filesystem>
+#include "OutputFile.h"
 #include "Util.h"
 
 #ifndef FRIDA_TEMPLATE_DIR
@@ -12,10 +12,10 @@ void FridaWriter::Create(const char* filename)
 {
 	std::filesystem::copy_file(FRIDA_TEMPLATE_DIR "/frida.template.js", filename, std::filesystem::copy_options::overwrite_existing);
 
-	std::ofstream of(filename, std::ios_base::app);
+	OutputFile of(filename, true);
 
 	of << "const ClassIdTagPos = " << kUntaggedObjectClassIdTagPos << ";\n";
-	of << std::format("const ClassIdTagMask = {:#x};\n", (1 << dart::UntaggedObject::kClassIdTagSize) - 1);
+	OutputFile::Format(of, "const ClassIdTagMask = {:#x};\n", (1 << dart::UntaggedObject::kClassIdTagSize) - 1);
 
 	of << "const NumPredefinedCids = " << dart::kNumPredefinedCids << ";\n";
 	of << "const CidObject = " << dart::kInstanceCid << ";\n";
@@ -156,4 +156,5 @@ void FridaWriter::Create(const char* filename)
 		}
 	}
 	of << "];\n";
+	of.Close();
 }
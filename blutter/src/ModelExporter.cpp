@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "ModelExporter.h"
+#include "Util.h"
+#include <fstream>
+
+void ModelExporter::Collect()
+{
+	// export all types in type database first in stable order. types found later are appended.
+	{
+		auto typeDb = app.TypeDb();
+		std::vector<std::pair<intptr_t, DartAbstractType*>> dbTypes(typeDb->typesMap.begin(), typeDb->typesMap.end());
+		std::sort(dbTypes.begin(), dbTypes.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		for (auto& [_, type] : dbTypes)
+			addType(type);
+	}
+
+	for (auto lib : app.libs) {
+		const auto libIdx = (uint32_t)libraries.size();
+		libraries.push_back(ModelFormat::Library{ addString(lib->name), addString(lib->url), (uint32_t)classes.size(), 0 });
+
+		for (auto cls : lib->classes) {
+			const auto clsIdx = (uint32_t)classes.size();
+			classes.push_back(ModelFormat::Class{
+				.cid = cls->Id(),
+				.name = addString(cls->FullName()),
+				.library = libIdx,
+				.parentCid = cls->Parent() ? cls->Parent()->Id() : ModelFormat::NoRef,
+				.instanceSize = cls->Size(),
+				.typeArgumentsOffset = cls->TypeArgumentsOffset(),
+				.unboxedFieldsBitmap = cls->FieldBitmap(),
+				.firstField = (uint32_t)fields.size(),
+				.numFields = (uint32_t)cls->Fields().size(),
+				.firstFunction = (uint32_t)functions.size(),
+			});
+
+			for (auto field : cls->Fields()) {
+				uint8_t flags = 0;
+				if (field->IsStatic())
+					flags |= ModelFormat::Field::Static;
+				if (field->IsLate())
+					flags |= ModelFormat::Field::Late;
+				if (field->IsFinal())
+					flags |= ModelFormat::Field::Final;
+				if (field->IsConst())
+					flags |= ModelFormat::Field::Const;
+				fields.push_back(ModelFormat::Field{ addString(field->Name()), addType(field->Type()), field->Offset(), flags });
+			}
+
+			for (auto dartFn : cls->Functions())
+				addFunction(*dartFn, clsIdx);
+			classes[clsIdx].numFunctions = (uint32_t)functions.size() - classes[clsIdx].firstFunction;
+		}
+		libraries[libIdx].numClasses = (uint32_t)classes.size() - libraries[libIdx].firstClass;
+	}
+
+	for (auto stub : app.Stubs())
+		stubs.push_back(ModelFormat::Stub{ stub->Address(), (uint32_t)stub->Size(), addString(stub->FullName()) });
+
+	collectPool();
+}
+
+uint32_t ModelExporter::addString(const std::string& s)
+{
+	auto [itr, inserted] = stringIdxs.try_emplace(s, (uint32_t)strings.size());
+	if (inserted)
+		strings.push_back(s);
+	return itr->second;
+}
+
+uint32_t ModelExporter::addType(DartAbstractType* type)
+{
+	if (type == nullptr)
+		return ModelFormat::NoRef;
+	auto itr = typeIdxs.find(type);
+	if (itr != typeIdxs.end())
+		return itr->second;
+
+	const auto idx = (uint32_t)types.size();
+	typeIdxs[type] = idx;
+	types.push_back(ModelFormat::Type{
+		.text = addString(type->ToString()),
+		.cid = type->IsType() ? type->AsType()->Class().Id() : ModelFormat::NoRef,
+		.kind = (uint8_t)type->GetKind(),
+		.nullable = type->IsNullable(),
+	});
+	return idx;
+}
+
+void ModelExporter::addFunction(DartFunction& dartFn, uint32_t clsIdx)
+{
+	auto& sig = dartFn.Signature();
+	ModelFormat::Function rec{
+		.address = dartFn.Address(),
+		.size = (uint32_t)dartFn.Size(),
+		.name = addString(dartFn.Name()),
+		.cls = clsIdx,
+		.returnType = addType(sig.ReturnType()),
+		.firstSignatureParam = (uint32_t)sigParams.size(),
+		.numSignatureParams = (uint16_t)sig.NumParam(),
+		.numOptionalSignatureParams = (uint16_t)sig.NumOptionalParam(),
+		.kind = (uint8_t)dartFn.Kind(),
+		.firstParam = (uint32_t)params.size(),
+		.firstIL = (uint32_t)ils.size(),
+	};
+	if (dartFn.IsNative())
+		rec.flags |= ModelFormat::Function::Native;
+	if (dartFn.IsClosure())
+		rec.flags |= ModelFormat::Function::Closure;
+	if (dartFn.IsFfi())
+		rec.flags |= ModelFormat::Function::Ffi;
+	if (dartFn.IsStatic())
+		rec.flags |= ModelFormat::Function::Static;
+	if (dartFn.IsConst())
+		rec.flags |= ModelFormat::Function::Const;
+	if (dartFn.IsAbstract())
+		rec.flags |= ModelFormat::Function::Abstract;
+	if (dartFn.IsAsync())
+		rec.flags |= ModelFormat::Function::Async;
+	if (sig.HasNamedParam())
+		rec.flags |= ModelFormat::Function::HasNamedParam;
+
+	for (auto& param : sig.Params())
+		sigParams.push_back(ModelFormat::SignatureParam{ addString(param.name), addType(param.type), param.isRequired });
+
+#ifndef NO_CODE_ANALYSIS
+	auto fnInfo = dartFn.GetAnalyzedData();
+	if (fnInfo) {
+		rec.flags |= ModelFormat::Function::Analyzed;
+		if (fnInfo->params.isNamedParam)
+			rec.flags |= ModelFormat::Function::NamedParams;
+		rec.numFixedParams = fnInfo->params.numFixedParam;
+		for (auto& param : fnInfo->params.params) {
+			params.push_back(ModelFormat::Param{
+				.name = addString(param.name),
+				.type = addType(param.type),
+				.paramOffset = param.paramOffset,
+				.localOffset = param.localOffset,
+				.paramReg = (int8_t)param.paramReg.value(),
+				.valReg = (int8_t)param.valReg.value(),
+				.defaultValue = param.HasValue() ? addString(param.ValueText()) : ModelFormat::NoRef,
+			});
+		}
+		fnInfo->ils.ForEach([&](const ILStream::Entry& il) {
+			ils.push_back(ModelFormat::IL{
+				.start = (uint32_t)(il.range.start - rec.address),
+				.end = (uint32_t)(il.range.end - rec.address),
+				.text = addString(std::string{ il.text }),
+				.kind = (uint8_t)il.kind,
+			});
+		});
+		rec.numParams = (uint32_t)params.size() - rec.firstParam;
+		rec.numILs = (uint32_t)ils.size() - rec.firstIL;
+	}
+#endif
+
+	functions.push_back(rec);
+}
+
+void ModelExporter::collectPool()
+{
+	const auto& pool = app.GetObjectPool();
+	const auto num = pool.Length();
+	auto& obj = dart::Object::Handle();
+	for (intptr_t i = 0; i < num; i++) {
+		// same offset as in compiled code (see DartDumper::DumpObjectPool())
+		const auto offset = dart::ObjectPool::OffsetFromIndex(i) + 1;
+		const auto entryType = pool.TypeAt(i);
+		uint32_t cid = ModelFormat::NoRef;
+		if (entryType == dart::ObjectPool::EntryType::kTaggedObject) {
+			obj = pool.ObjectAt(i);
+			cid = (uint32_t)obj.GetClassId();
+		}
+		// remove "[pp+0x...] " prefix
+		const auto& desc = dumper.getPoolDescription(offset, false);
+		poolEntries.push_back(ModelFormat::PoolEntry{ (uint32_t)offset, cid, addString(desc.substr(desc.find("] ") + 2)), (uint8_t)entryType });
+		// UnlinkedCall description contains its next entry
+		if (cid == dart::kUnlinkedCallCid)
+			i++;
+	}
+}
+
+const std::string& ModelExporter::str(uint32_t idx) const
+{
+	static const std::string empty;
+	return idx == ModelFormat::NoRef ? empty : strings[idx];
+}
+
+template <typename T>
+static void writeSection(std::ostream& of, ModelFormat::SectionId id, const std::vector<T>& records, uint32_t& numSections)
+{
+	numSections++;
+	const uint32_t header[3] = { id, (uint32_t)records.size(), (uint32_t)sizeof(T) };
+	of.write((const char*)header, sizeof(header));
+	of.write((const char*)records.data(), records.size() * sizeof(T));
+}
+
+void ModelExporter::WriteBinary(const std::filesystem::path& path) const
+{
+	std::ofstream of{ path, std::ios::binary };
+	if (!of)
+		throw std::runtime_error(std::format("Cannot create model file {}", path.string()));
+
+	of.write(ModelFormat::Magic, sizeof(ModelFormat::Magic));
+	// number of sections is written after all sections are written
+	uint32_t numSections = 0;
+	const uint32_t fileHeader[2] = { ModelFormat::Version, numSections };
+	of.write((const char*)fileHeader, sizeof(fileHeader));
+
+	std::vector<uint32_t> strOffsets;
+	strOffsets.reserve(strings.size() + 1);
+	uint32_t strDataSize = 0;
+	for (const auto& s : strings) {
+		strOffsets.push_back(strDataSize);
+		strDataSize += (uint32_t)s.size();
+	}
+	strOffsets.push_back(strDataSize);
+	const uint32_t strHeader[3] = { ModelFormat::Strings, (uint32_t)strings.size(), (uint32_t)sizeof(uint32_t) };
+	of.write((const char*)strHeader, sizeof(strHeader));
+	of.write((const char*)strOffsets.data(), strOffsets.size() * sizeof(uint32_t));
+	of.write((const char*)&strDataSize, sizeof(strDataSize));
+	for (const auto& s : strings)
+		of.write(s.data(), s.size());
+	numSections++;
+
+	writeSection(of, ModelFormat::Libraries, libraries, numSections);
+	writeSection(of, ModelFormat::Classes, classes, numSections);
+	writeSection(of, ModelFormat::Fields, fields, numSections);
+	writeSection(of, ModelFormat::Functions, functions, numSections);
+	writeSection(of, ModelFormat::SignatureParams, sigParams, numSections);
+	writeSection(of, ModelFormat::Params, params, numSections);
+	writeSection(of, ModelFormat::ILs, ils, numSections);
+	writeSection(of, ModelFormat::PoolEntries, poolEntries, numSections);
+	writeSection(of, ModelFormat::Types, types, numSections);
+	writeSection(of, ModelFormat::Stubs, stubs, numSections);
+
+	of.seekp(sizeof(ModelFormat::Magic) + sizeof(uint32_t));
+	of.write((const char*)&numSections, sizeof(numSections));
+	if (!of.flush())
+		throw std::runtime_error(std::format("Cannot write model file {}", path.string()));
+}
+
+static std::string jsonRef(uint32_t idx)
+{
+	return idx == ModelFormat::NoRef ? "null" : std::to_string(idx);
+}
+
+void ModelExporter::WriteJson(const std::filesystem::path& path) const
+{
+	std::ofstream of{ path };
+	if (!of)
+		throw std::runtime_error(std::format("Cannot create model file {}", path.string()));
+
+	// one record per line. a record refers to types, libraries and classes by index of the same kind in written order.
+	of << std::format("{{\"kind\":\"header\",\"format\":\"blutter-model\",\"version\":{},\"snapshot_hash\":{}}}\n",
+		ModelFormat::Version, Util::JsonQuote(app.SnapshotHash()));
+
+	for (size_t i = 0; i < types.size(); i++) {
+		const auto& type = types[i];
+		of << std::format("{{\"kind\":\"type\",\"id\":{},\"text\":{},\"type_kind\":{},\"nullable\":{},\"cid\":{}}}\n",
+			i, Util::JsonQuote(str(type.text)), type.kind, type.nullable != 0, jsonRef(type.cid));
+	}
+
+	for (size_t i = 0; i < libraries.size(); i++) {
+		const auto& lib = libraries[i];
+		of << std::format("{{\"kind\":\"library\",\"id\":{},\"name\":{},\"url\":{}}}\n",
+			i, Util::JsonQuote(str(lib.name)), Util::JsonQuote(str(lib.url)));
+	}
+
+	std::string line;
+	for (size_t i = 0; i < classes.size(); i++) {
+		const auto& cls = classes[i];
+		line = std::format("{{\"kind\":\"class\",\"id\":{},\"cid\":{},\"name\":{},\"library\":{},\"parent_cid\":{},\"size\":{},"
+			"\"type_args_offset\":{},\"unboxed_bitmap\":{},\"fields\":[",
+			i, cls.cid, Util::JsonQuote(str(cls.name)), cls.library, jsonRef(cls.parentCid), cls.instanceSize,
+			cls.typeArgumentsOffset, cls.unboxedFieldsBitmap);
+		for (uint32_t j = 0; j < cls.numFields; j++) {
+			const auto& field = fields[cls.firstField + j];
+			line += std::format("{}{{\"name\":{},\"type\":{},\"offset\":{},\"flags\":{}}}", j == 0 ? "" : ",",
+				Util::JsonQuote(str(field.name)), jsonRef(field.type), field.offset, field.flags);
+		}
+		line += "]}\n";
+		of << line;
+	}
+
+	for (size_t i = 0; i < functions.size(); i++) {
+		const auto& fn = functions[i];
+		line = std::format("{{\"kind\":\"function\",\"id\":{},\"address\":{},\"size\":{},\"name\":{},\"class\":{},\"function_kind\":{},"
+			"\"flags\":{},\"return_type\":{},\"num_optional_signature_params\":{},\"signature_params\":[",
+			i, fn.address, fn.size, Util::JsonQuote(str(fn.name)), fn.cls, fn.kind, fn.flags, jsonRef(fn.returnType),
+			fn.numOptionalSignatureParams);
+		for (uint32_t j = 0; j < fn.numSignatureParams; j++) {
+			const auto& param = sigParams[fn.firstSignatureParam + j];
+			line += std::format("{}{{\"name\":{},\"type\":{},\"required\":{}}}", j == 0 ? "" : ",",
+				Util::JsonQuote(str(param.name)), jsonRef(param.type), param.isRequired != 0);
+		}
+		line += std::format("],\"num_fixed_params\":{},\"params\":[", fn.numFixedParams);
+		for (uint32_t j = 0; j < fn.numParams; j++) {
+			const auto& param = params[fn.firstParam + j];
+			line += std::format("{}{{\"name\":{},\"type\":{},\"param_offset\":{},\"local_offset\":{},\"param_reg\":{},\"val_reg\":{},\"default\":{}}}",
+				j == 0 ? "" : ",", Util::JsonQuote(str(param.name)), jsonRef(param.type), param.paramOffset, param.localOffset,
+				param.paramReg, param.valReg, param.defaultValue == ModelFormat::NoRef ? "null" : Util::JsonQuote(str(param.defaultValue)));
+		}
+		line += "],\"il\":[";
+		for (uint32_t j = 0; j < fn.numILs; j++) {
+			const auto& il = ils[fn.firstIL + j];
+			line += std::format("{}{{\"start\":{},\"end\":{},\"kind\":{},\"text\":{}}}", j == 0 ? "" : ",",
+				il.start, il.end, il.kind, Util::JsonQuote(str(il.text)));
+		}
+		line += "]}\n";
+		of << line;
+	}
+
+	for (const auto& stub : stubs) {
+		of << std::format("{{\"kind\":\"stub\",\"address\":{},\"size\":{},\"name\":{}}}\n",
+			stub.address, stub.size, Util::JsonQuote(str(stub.name)));
+	}
+
+	for (const auto& entry : poolEntries) {
+		of << std::format("{{\"kind\":\"pool\",\"offset\":{},\"entry_type\":{},\"cid\":{},\"description\":{}}}\n",
+			entry.offset, entry.entryType, jsonRef(entry.cid), Util::JsonQuote(str(entry.description)));
+	}
+
+	if (!of.flush())
+		throw std::runtime_error(std::format("Cannot write model file {}", path.string()));
+}
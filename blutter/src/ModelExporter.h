@@ -0,0 +1,201 @@
+#pragma once
+#include "DartDumper.h"
+#include <filesystem>
+
+// Binary model format. All values are little endian. A file is
+//   "BLUTMODL", u32 version, u32 number of sections
+// then each section is
+//   u32 section id, u32 number of records, u32 record size, records
+// The Strings section is special. Its records are u32 offsets of each string in the string data (plus the end offset),
+// followed by u32 size of the string data and the string data. Strings are not null terminated.
+// A string or record reference is the index in its section. NoRef is used for nothing.
+// Addresses are offsets from the libapp base.
+namespace ModelFormat {
+	constexpr char Magic[8] = { 'B', 'L', 'U', 'T', 'M', 'O', 'D', 'L' };
+	constexpr uint32_t Version = 1;
+	constexpr uint32_t NoRef = 0xffffffff;
+
+	enum SectionId : uint32_t {
+		Strings = 1,
+		Libraries,
+		Classes,
+		Fields,
+		Functions,
+		SignatureParams,
+		Params,
+		ILs,
+		PoolEntries,
+		Types,
+		Stubs,
+	};
+
+// records have no padding, so they are written as they are in memory
+	struct Library {
+		uint32_t name;
+		uint32_t url;
+		uint32_t firstClass;
+		uint32_t numClasses;
+	};
+	static_assert(sizeof(Library) == 16);
+
+	struct Class {
+		uint32_t cid;
+		uint32_t name;
+		uint32_t library;
+		uint32_t parentCid; // NoRef for no parent
+		int32_t instanceSize;
+		int32_t typeArgumentsOffset;
+		uint64_t unboxedFieldsBitmap;
+		uint32_t firstField;
+		uint32_t numFields;
+		uint32_t firstFunction;
+		uint32_t numFunctions;
+	};
+	static_assert(sizeof(Class) == 48);
+
+	struct Field {
+		enum Flags : uint8_t {
+			Static = 1,
+			Late = 2,
+			Final = 4,
+			Const = 8,
+		};
+		uint32_t name;
+		uint32_t type;
+		uint32_t offset;
+		uint8_t flags;
+		uint8_t reserved[3];
+	};
+	static_assert(sizeof(Field) == 16);
+
+	struct Function {
+		enum Flags : uint16_t {
+			Native = 1,
+			Closure = 2,
+			Ffi = 4,
+			Static = 8,
+			Const = 0x10,
+			Abstract = 0x20,
+			Async = 0x40,
+			HasNamedParam = 0x80, // in signature
+			Analyzed = 0x100, // Params and ILs are available
+			NamedParams = 0x200, // optional params of analysis are named params
+		};
+		uint64_t address;
+		uint32_t size;
+		uint32_t name;
+		uint32_t cls;
+		uint32_t returnType;
+		uint32_t firstSignatureParam;
+		uint16_t numSignatureParams;
+		uint16_t numOptionalSignatureParams;
+		uint16_t flags;
+		uint8_t kind; // DartFunction::FunctionKind
+		uint8_t numFixedParams;
+		uint32_t firstParam;
+		uint32_t numParams;
+		uint32_t firstIL;
+		uint32_t numILs;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(Function) == 56);
+
+	struct SignatureParam {
+		uint32_t name;
+		uint32_t type;
+		uint32_t isRequired;
+	};
+	static_assert(sizeof(SignatureParam) == 12);
+
+	// parameter from code analysis
+	struct Param {
+		uint32_t name;
+		uint32_t type;
+		int32_t paramOffset; // offset from FP. 0 if it is passed with register or it is optional param.
+		int32_t localOffset; // offset from FP of local variable
+		int8_t paramReg; // A64::Register. -1 for none.
+		int8_t valReg;
+		uint8_t reserved[2];
+		uint32_t defaultValue;
+	};
+	static_assert(sizeof(Param) == 24);
+
+	struct IL {
+		uint32_t start; // offset from function address
+		uint32_t end;
+		uint32_t text;
+		uint8_t kind; // ILInstr::ILKind
+		uint8_t reserved[3];
+	};
+	static_assert(sizeof(IL) == 16);
+
+	struct PoolEntry {
+		uint32_t offset; // offset in compiled code (from PP register)
+		uint32_t cid; // class id of tagged object. NoRef for other entry type.
+		uint32_t description;
+		uint8_t entryType; // dart::ObjectPool::EntryType
+		uint8_t reserved[3];
+	};
+	static_assert(sizeof(PoolEntry) == 16);
+
+	struct Type {
+		uint32_t text;
+		uint32_t cid; // class id for DartType. NoRef for other kinds.
+		uint8_t kind; // DartAbstractType::Kind
+		uint8_t nullable;
+		uint8_t reserved[2];
+	};
+	static_assert(sizeof(Type) == 12);
+
+	struct Stub {
+		uint64_t address;
+		uint32_t size;
+		uint32_t name;
+	};
+	static_assert(sizeof(Stub) == 16);
+}
+
+// Exports libraries, classes, functions (with analysis result if available), Object Pool entries and types for other tools.
+// The model is collected once then written as binary (see ModelFormat) or JSON lines (one object per line).
+class ModelExporter
+{
+public:
+	ModelExporter(DartApp& app, DartDumper& dumper) : app(app), dumper(dumper) {}
+	ModelExporter() = delete;
+	ModelExporter(const ModelExporter&) = delete;
+	ModelExporter(ModelExporter&&) = delete;
+	ModelExporter& operator=(const ModelExporter&) = delete;
+
+	// must be in DartApp scope
+	void Collect();
+	void WriteBinary(const std::filesystem::path& path) const;
+	void WriteJson(const std::filesystem::path& path) const;
+
+	size_t NumFunctions() const { return functions.size(); }
+
+private:
+	uint32_t addString(const std::string& s);
+	uint32_t addType(DartAbstractType* type);
+	void addFunction(DartFunction& dartFn, uint32_t clsIdx);
+	void collectPool();
+
+	const std::string& str(uint32_t idx) const;
+
+	DartApp& app;
+	DartDumper& dumper;
+
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, uint32_t> stringIdxs;
+	std::unordered_map<DartAbstractType*, uint32_t> typeIdxs;
+
+	std::vector<ModelFormat::Library> libraries;
+	std::vector<ModelFormat::Class> classes;
+	std::vector<ModelFormat::Field> fields;
+	std::vector<ModelFormat::Function> functions;
+	std::vector<ModelFormat::SignatureParam> sigParams;
+	std::vector<ModelFormat::Param> params;
+	std::vector<ModelFormat::IL> ils;
+	std::vector<ModelFormat::PoolEntry> poolEntries;
+	std::vector<ModelFormat::Type> types;
+	std::vector<ModelFormat::Stub> stubs;
+};
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "OutputFile.h"
+#include <cerrno>
+#include <cstring>
+
+OutputFile::Buffer::Buffer(std::FILE* fp) : fp(fp), data(new char[BufferSize])
+{
+	setp(data.get(), data.get() + BufferSize);
+}
+
+bool OutputFile::Buffer::write(const char* s, size_t size)
+{
+	if (std::fwrite(s, 1, size, fp) != size)
+		failed = true;
+	return !failed;
+}
+
+bool OutputFile::Buffer::Flush()
+{
+	const auto size = (size_t)(pptr() - pbase());
+	setp(data.get(), data.get() + BufferSize);
+	return size == 0 || write(data.get(), size);
+}
+
+OutputFile::Buffer::int_type OutputFile::Buffer::overflow(int_type ch)
+{
+	if (!Flush())
+		return traits_type::eof();
+	if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+		*pptr() = traits_type::to_char_type(ch);
+		pbump(1);
+	}
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize OutputFile::Buffer::xsputn(const char* s, std::streamsize n)
+{
+	if (n <= epptr() - pptr()) {
+		memcpy(pptr(), s, (size_t)n);
+		pbump((int)n);
+		return n;
+	}
+	if (!Flush())
+		return 0;
+	// big data is written directly without copying to the buffer
+	if (n >= (std::streamsize)BufferSize)
+		return write(s, (size_t)n) ? n : 0;
+	memcpy(pptr(), s, (size_t)n);
+	pbump((int)n);
+	return n;
+}
+
+int OutputFile::Buffer::sync()
+{
+	return Flush() ? 0 : -1;
+}
+
+OutputFile::OutputFile(const std::filesystem::path& path, bool append) : std::ostream(nullptr), path(path)
+{
+#ifdef _WIN32
+	fp = _wfopen(path.c_str(), append ? L"ab" : L"wb");
+#else
+	fp = std::fopen(path.c_str(), append ? "ab" : "wb");
+#endif
+	if (fp == nullptr)
+		throw std::runtime_error(std::format("Cannot create file {}: {}", path.string(), strerror(errno)));
+	// the FILE is only used for big writes. its own buffer is just an extra copy.
+	std::setvbuf(fp, nullptr, _IONBF, 0);
+	buf = std::make_unique<Buffer>(fp);
+	rdbuf(buf.get());
+}
+
+OutputFile::~OutputFile()
+{
+	if (fp) {
+		buf->Flush();
+		std::fclose(fp);
+	}
+}
+
+void OutputFile::Close()
+{
+	if (fp == nullptr)
+		return;
+	const bool ok = buf->Flush() && !buf->Failed() && !bad();
+	const bool closed = std::fclose(fp) == 0;
+	fp = nullptr;
+	// no more output. later writes only set badbit.
+	rdbuf(nullptr);
+	if (!ok || !closed)
+		throw std::runtime_error(std::format("Cannot write file {}", path.string()));
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+
+// Text output file for dumpers. It is a std::ostream with one large buffer, so existing "<<" code works
+// and the file is written with a few big writes instead of iostream's small ones.
+// Format() formats straight into the buffer without a temporary std::string.
+class OutputFile : public std::ostream
+{
+public:
+	// throws std::runtime_error if the file cannot be opened
+	explicit OutputFile(const std::filesystem::path& path, bool append = false);
+	// flushes remaining data. errors are ignored here, call Close() to get them.
+	~OutputFile();
+	OutputFile() = delete;
+	OutputFile(const OutputFile&) = delete;
+	OutputFile(OutputFile&&) = delete;
+	OutputFile& operator=(const OutputFile&) = delete;
+
+	// flushes and closes the file. throws std::runtime_error on a write error.
+	void Close();
+
+	// format into any stream. for OutputFile (or other buffered stream), characters go to the stream buffer directly.
+	template <typename... Args>
+	static void Format(std::ostream& os, std::format_string<Args...> fmt, Args&&... args) {
+		std::format_to(std::ostreambuf_iterator<char>(os), fmt, std::forward<Args>(args)...);
+	}
+
+	static constexpr size_t BufferSize = 1 << 20;
+
+private:
+	class Buffer : public std::streambuf {
+	public:
+		explicit Buffer(std::FILE* fp);
+		bool Flush();
+		// a write has failed. it is sticky because Format() ignores the result of overflow().
+		bool Failed() const { return failed; }
+
+	protected:
+		virtual int_type overflow(int_type ch) override;
+		virtual std::streamsize xsputn(const char* s, std::streamsize n) override;
+		virtual int sync() override;
+
+	private:
+		bool write(const char* data, size_t size);
+
+		std::FILE* fp;
+		std::unique_ptr<char[]> data;
+		bool failed{ false };
+	};
+
+	std::filesystem::path path;
+	std::FILE* fp;
+	std::unique_ptr<Buffer> buf;
+};
@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "PhaseStats.h"
+#include "WorkerPool.h"
+#include <fstream>
+#include <stdexcept>
+#if defined(_WIN32) || defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+void PhaseStats::Begin(std::string name, std::filesystem::path outPath)
+{
+	if (running)
+		End();
+
+	phases.push_back(Phase{ .name = std::move(name) });
+	this->outPath = std::move(outPath);
+	running = true;
+	startZoneBytes = ZoneBytes();
+	startCpuTime = ProcessCpuTime();
+	startTime = std::chrono::steady_clock::now();
+}
+
+void PhaseStats::End()
+{
+	if (!running)
+		return;
+
+	const auto endTime = std::chrono::steady_clock::now();
+	auto& phase = phases.back();
+	phase.wallTime = std::chrono::duration<double>(endTime - startTime).count();
+	phase.cpuTime = ProcessCpuTime() - startCpuTime;
+	phase.peakRss = PeakRss();
+	phase.zoneBytes = ZoneBytes() - startZoneBytes;
+	if (!outPath.empty())
+		phase.outputBytes = OutputSize(outPath);
+	running = false;
+}
+
+void PhaseStats::AddCount(std::string name, uint64_t value)
+{
+	if (phases.empty())
+		throw std::logic_error("No phase for adding a count");
+	phases.back().counts.emplace_back(std::move(name), value);
+}
+
+void PhaseStats::WriteJson(const std::filesystem::path& path) const
+{
+	std::ofstream of(path);
+	if (!of)
+		throw std::runtime_error("Cannot create stats file " + path.string());
+
+	of << "{\n  \"phases\": [\n";
+	for (size_t i = 0; i < phases.size(); i++) {
+		const auto& phase = phases[i];
+		of << std::format("    {{\"name\": \"{}\", \"wall_time\": {:.6f}, \"cpu_time\": {:.6f}, \"peak_rss\": {}, \"zone_bytes\": {}, \"output_bytes\": {}",
+			phase.name, phase.wallTime, phase.cpuTime, phase.peakRss, phase.zoneBytes, phase.outputBytes);
+		of << ", \"counts\": {";
+		for (size_t j = 0; j < phase.counts.size(); j++) {
+			of << std::format("{}\"{}\": {}", j == 0 ? "" : ", ", phase.counts[j].first, phase.counts[j].second);
+		}
+		of << "}}" << (i + 1 < phases.size() ? ",\n" : "\n");
+	}
+	of << "  ]\n}\n";
+}
+
+#ifdef _WIN32
+static double fileTimeToSeconds(const FILETIME& ft)
+{
+	ULARGE_INTEGER val;
+	val.LowPart = ft.dwLowDateTime;
+	val.HighPart = ft.dwHighDateTime;
+	// FILETIME unit is 100 nanoseconds
+	return (double)val.QuadPart / 10000000.0;
+}
+
+double PhaseStats::ProcessCpuTime()
+{
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+		return 0;
+	return fileTimeToSeconds(kernelTime) + fileTimeToSeconds(userTime);
+}
+
+uint64_t PhaseStats::PeakRss()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return pmc.PeakWorkingSetSize;
+}
+#else
+double PhaseStats::ProcessCpuTime()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+uint64_t PhaseStats::PeakRss()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	// macOS reports in bytes
+	return usage.ru_maxrss;
+#else
+	// Linux reports in kilobytes
+	return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+#endif
+
+int64_t PhaseStats::ZoneBytes()
+{
+	int64_t total = WorkerPool::ZoneBytes();
+	auto thread = dart::Thread::Current();
+	if (thread != nullptr && thread->zone() != nullptr)
+		total += thread->zone()->SizeInBytes();
+	return total;
+}
+
+uint64_t PhaseStats::OutputSize(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	if (std::filesystem::is_regular_file(path, ec))
+		return std::filesystem::file_size(path, ec);
+
+	uint64_t total = 0;
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(path, ec)) {
+		if (entry.is_regular_file(ec))
+			total += entry.file_size(ec);
+	}
+	return total;
+}
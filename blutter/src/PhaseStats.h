@@ -0,0 +1,50 @@
+#pragma once
+#include <chrono>
+#include <filesystem>
+
+// Collects timing and memory usage of each blutter phase (loading, analysis, dumping)
+// so a regression can be located to one phase. The report is written as JSON.
+class PhaseStats
+{
+public:
+	struct Phase {
+		std::string name;
+		double wallTime{ 0 }; // seconds
+		double cpuTime{ 0 }; // seconds (all threads)
+		uint64_t peakRss{ 0 }; // bytes, process peak at the end of phase
+		int64_t zoneBytes{ 0 }; // bytes allocated in Dart zones while running the phase
+		uint64_t outputBytes{ 0 };
+		std::vector<std::pair<std::string, uint64_t>> counts;
+	};
+
+	PhaseStats() = default;
+	PhaseStats(const PhaseStats&) = delete;
+	PhaseStats(PhaseStats&&) = delete;
+	PhaseStats& operator=(const PhaseStats&) = delete;
+
+	// outPath is the file or directory written by the phase. it is used for counting output bytes.
+	void Begin(std::string name, std::filesystem::path outPath = {});
+	void End();
+	// add a count to the current phase or the last ended phase
+	void AddCount(std::string name, uint64_t value);
+
+	const std::vector<Phase>& Phases() const { return phases; }
+	void WriteJson(const std::filesystem::path& path) const;
+
+	// process wide CPU time (user + system) in seconds
+	static double ProcessCpuTime();
+	// process peak resident memory in bytes
+	static uint64_t PeakRss();
+	// bytes allocated in zones of current Dart thread and of finished worker threads
+	static int64_t ZoneBytes();
+	// size of a file or total size of files in a directory
+	static uint64_t OutputSize(const std::filesystem::path& path);
+
+private:
+	std::vector<Phase> phases;
+	bool running{ false };
+	std::filesystem::path outPath;
+	std::chrono::steady_clock::time_point startTime;
+	double startCpuTime{ 0 };
+	int64_t startZoneBytes{ 0 };
+};
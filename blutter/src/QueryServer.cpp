@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "QueryServer.h"
+#include "CodeAnalyzer.h"
+#include "Util.h"
+#include <sstream>
+
+void QueryServer::Run(std::istream& in, std::ostream& out)
+{
+	out << "{\"ready\":true}" << std::endl;
+
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line == "\r")
+			continue;
+
+		std::string id = "null";
+		std::string resp;
+		try {
+			const auto req = parseRequest(line);
+			auto itr = req.find("id");
+			if (itr != req.end())
+				id = Util::JsonQuote(itr->second);
+			itr = req.find("cmd");
+			if (itr != req.end() && itr->second == "quit")
+				break;
+			resp = std::format("{{\"id\":{},\"ok\":true,\"result\":{}}}", id, handle(req));
+		}
+		catch (std::exception& e) {
+			resp = std::format("{{\"id\":{},\"ok\":false,\"error\":{}}}", id, Util::JsonQuote(e.what()));
+		}
+		// flush every response for interactive clients
+		out << resp << std::endl;
+	}
+}
+
+std::string QueryServer::handle(const Request& req)
+{
+	const auto itr = req.find("cmd");
+	if (itr == req.end())
+		throw std::runtime_error("no cmd");
+	const auto& cmd = itr->second;
+	if (cmd == "function")
+		return queryFunction(req);
+	if (cmd == "asm")
+		return queryAsm(req);
+	if (cmd == "il")
+		return queryIL(req);
+	if (cmd == "pool")
+		return queryPool(req);
+	if (cmd == "class")
+		return queryClass(req);
+	if (cmd == "xrefs")
+		return queryXrefs(req);
+	throw std::runtime_error(std::format("unknown cmd '{}'", cmd));
+}
+
+std::string QueryServer::queryFunction(const Request& req)
+{
+	if (req.contains("addr")) {
+		const auto addr = getNumber(req, "addr");
+		// a query must not split a big stub. the piece that is split while analyzing is returned if any.
+		auto fnBase = app.FindFunction(addr);
+		if (fnBase == nullptr)
+			throw std::runtime_error(std::format("no function at {:#x}", addr));
+		return '[' + functionToJson(*fnBase) + ']';
+	}
+
+	const auto itr = req.find("name");
+	if (itr == req.end())
+		throw std::runtime_error("no addr or name");
+	buildNameIndex();
+	std::string res = "[";
+	auto [first, last] = nameIndex.equal_range(itr->second);
+	for (auto it = first; it != last; ++it) {
+		if (res.size() > 1)
+			res += ',';
+		res += functionToJson(*it->second);
+	}
+	res += ']';
+	return res;
+}
+
+std::string QueryServer::queryAsm(const Request& req)
+{
+#ifndef NO_CODE_ANALYSIS
+	auto& dartFn = findFunction(req);
+	ensureAnalyzed(dartFn);
+	std::ostringstream ss;
+	dumper.DumpFunctionAsm(ss, dartFn);
+	return std::format("{{\"address\":{},\"text\":{}}}", dartFn.Address(), Util::JsonQuote(ss.str()));
+#else
+	throw std::runtime_error("blutter is built without code analysis");
+#endif
+}
+
+std::string QueryServer::queryIL(const Request& req)
+{
+#ifndef NO_CODE_ANALYSIS
+	auto& dartFn = findFunction(req);
+	ensureAnalyzed(dartFn);
+	std::string res = "[";
+	if (dartFn.Size() > 0) {
+		dartFn.GetAnalyzedData()->ils.ForEach([&res](const ILStream::Entry& il) {
+			if (il.kind == ILInstr::Unknown)
+				return;
+			if (res.size() > 1)
+				res += ',';
+			res += std::format("{{\"start\":{},\"end\":{},\"kind\":{},\"text\":{}}}", il.range.start, il.range.end, (int)il.kind,
+				Util::JsonQuote(std::string{ il.text }));
+		});
+	}
+	res += ']';
+	return res;
+#else
+	throw std::runtime_error("blutter is built without code analysis");
+#endif
+}
+
+std::string QueryServer::queryPool(const Request& req)
+{
+	const auto offset = getNumber(req, "offset");
+	const auto& pool = app.GetObjectPool();
+	// offset in code is not subtracted by kHeapObjectTag
+	if (offset < (uint64_t)dart::ObjectPool::OffsetFromIndex(0) + 1 || (offset - 1) % dart::kWordSize != 0)
+		throw std::runtime_error(std::format("invalid pool offset {:#x}", offset));
+	const auto idx = dart::ObjectPool::IndexFromOffset(offset);
+	if (idx >= pool.Length())
+		throw std::runtime_error(std::format("pool offset {:#x} is out of range", offset));
+
+	return std::format("{{\"offset\":{},\"type\":{},\"simple\":{},\"full\":{}}}", offset, (int)pool.TypeAt(idx),
+		Util::JsonQuote(dumper.getPoolDescription(offset, true)), Util::JsonQuote(dumper.getPoolDescription(offset, false)));
+}
+
+std::string QueryServer::queryClass(const Request& req)
+{
+	if (req.contains("cid")) {
+		const auto cid = getNumber(req, "cid");
+		if (cid >= app.classes.size() || app.classes[cid] == nullptr)
+			throw std::runtime_error(std::format("no class with cid {}", cid));
+		return '[' + classToJson(*app.classes[cid]) + ']';
+	}
+
+	const auto itr = req.find("name");
+	if (itr == req.end())
+		throw std::runtime_error("no cid or name");
+	std::string res = "[";
+	for (auto cls : app.classes) {
+		if (cls == nullptr || (cls->Name() != itr->second && cls->FullName() != itr->second))
+			continue;
+		if (res.size() > 1)
+			res += ',';
+		res += classToJson(*cls);
+	}
+	res += ']';
+	return res;
+}
+
+std::string QueryServer::queryXrefs(const Request& req)
+{
+#ifndef NO_CODE_ANALYSIS
+	auto& dartFn = findFunction(req);
+	buildXrefIndex();
+	std::string res = "[";
+	const auto itr = xrefIndex.find(dartFn.Address());
+	if (itr != xrefIndex.end()) {
+		for (auto& [callAddr, caller] : itr->second) {
+			if (res.size() > 1)
+				res += ',';
+			res += std::format("{{\"address\":{},\"caller\":{},\"caller_name\":{}}}", callAddr, caller->Address(),
+				Util::JsonQuote(caller->FullName()));
+		}
+	}
+	res += ']';
+	return res;
+#else
+	throw std::runtime_error("blutter is built without code analysis");
+#endif
+}
+
+DartFunction& QueryServer::findFunction(const Request& req)
+{
+	if (req.contains("addr")) {
+		const auto addr = getNumber(req, "addr");
+		const auto entry = app.AddressIndex().Find(addr);
+		if (entry == nullptr || entry->fn->IsStub())
+			throw std::runtime_error(std::format("no function at {:#x}", addr));
+		return *entry->fn->AsFunction();
+	}
+
+	const auto itr = req.find("name");
+	if (itr == req.end())
+		throw std::runtime_error("no addr or name");
+	buildNameIndex();
+	const auto cnt = nameIndex.count(itr->second);
+	if (cnt == 0)
+		throw std::runtime_error(std::format("no function named '{}'", itr->second));
+	if (cnt > 1)
+		throw std::runtime_error(std::format("{} functions are named '{}'. use addr instead", cnt, itr->second));
+	return *nameIndex.find(itr->second)->second;
+}
+
+void QueryServer::ensureAnalyzed(DartFunction& dartFn)
+{
+#ifndef NO_CODE_ANALYSIS
+	if (dartFn.Size() == 0 || dartFn.GetAnalyzedData() != nullptr)
+		return;
+	if (analyzer == nullptr)
+		throw std::runtime_error("no code analyzer");
+	analyzer->AnalyzeFunction(dartFn);
+#endif
+}
+
+void QueryServer::buildNameIndex()
+{
+	if (!nameIndex.empty())
+		return;
+	for (auto lib : app.libs) {
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				auto fullName = dartFn->FullName();
+				auto name = dartFn->Name();
+				if (name != fullName)
+					nameIndex.emplace(std::move(name), dartFn);
+				nameIndex.emplace(std::move(fullName), dartFn);
+			}
+		}
+	}
+}
+
+void QueryServer::buildXrefIndex()
+{
+#ifndef NO_CODE_ANALYSIS
+	if (hasXrefIndex)
+		return;
+	if (analyzer == nullptr)
+		throw std::runtime_error("no code analyzer");
+	// functions that were queried before are not analyzed again
+	analyzer->AnalyzeAll();
+
+	for (auto lib : app.libs) {
+		if (lib->isInternal)
+			continue;
+		for (auto cls : lib->classes) {
+			for (auto dartFn : cls->Functions()) {
+				auto fnInfo = dartFn->GetAnalyzedData();
+				if (fnInfo == nullptr)
+					continue;
+				for (auto& asmText : fnInfo->asmTexts.Data()) {
+					if (asmText.dataType == AsmText::Call)
+						xrefIndex[asmText.callAddress].emplace_back(fnInfo->asmTexts.Address(asmText), dartFn);
+				}
+			}
+		}
+	}
+	hasXrefIndex = true;
+#endif
+}
+
+QueryServer::Request QueryServer::parseRequest(const std::string& line)
+{
+	// only a flat object with string, number, boolean or null values
+	Request req;
+	size_t pos = 0;
+	auto skipSpaces = [&] {
+		while (pos < line.size() && std::isspace((unsigned char)line[pos]))
+			pos++;
+	};
+	auto expect = [&](char c) {
+		skipSpaces();
+		if (pos >= line.size() || line[pos] != c)
+			throw std::runtime_error(std::format("invalid request. expect '{}' at {}", c, pos));
+		pos++;
+	};
+	auto parseString = [&] {
+		expect('"');
+		std::string s;
+		while (pos < line.size() && line[pos] != '"') {
+			char c = line[pos++];
+			if (c == '\\' && pos < line.size()) {
+				c = line[pos++];
+				switch (c) {
+				case 'n': c = '\n'; break;
+				case 'r': c = '\r'; break;
+				case 't': c = '\t'; break;
+				case 'b': c = '\b'; break;
+				case 'f': c = '\f'; break;
+				case 'u': {
+					if (pos + 4 > line.size())
+						throw std::runtime_error("invalid request. bad escape");
+					const auto code = std::stoul(line.substr(pos, 4), nullptr, 16);
+					pos += 4;
+					// names are ASCII. other characters are replaced.
+					c = code < 0x80 ? (char)code : '?';
+					break;
+				}
+				}
+			}
+			s += c;
+		}
+		expect('"');
+		return s;
+	};
+
+	expect('{');
+	skipSpaces();
+	if (pos < line.size() && line[pos] == '}')
+		return req;
+	while (true) {
+		auto key = parseString();
+		expect(':');
+		skipSpaces();
+		std::string val;
+		if (pos < line.size() && line[pos] == '"') {
+			val = parseString();
+		}
+		else {
+			const auto start = pos;
+			while (pos < line.size() && line[pos] != ',' && line[pos] != '}' && !std::isspace((unsigned char)line[pos]))
+				pos++;
+			val = line.substr(start, pos - start);
+			if (val.empty() || val[0] == '{' || val[0] == '[')
+				throw std::runtime_error("invalid request. only string and number values are supported");
+		}
+		req[std::move(key)] = std::move(val);
+		skipSpaces();
+		if (pos < line.size() && line[pos] == ',') {
+			pos++;
+			continue;
+		}
+		expect('}');
+		break;
+	}
+	return req;
+}
+
+uint64_t QueryServer::getNumber(const Request& req, const char* key)
+{
+	const auto itr = req.find(key);
+	if (itr == req.end())
+		throw std::runtime_error(std::format("no {}", key));
+	try {
+		size_t len;
+		// base 0 accepts both decimal and "0x" hex
+		const auto val = std::stoull(itr->second, &len, 0);
+		if (len == itr->second.size())
+			return val;
+	}
+	catch (std::exception&) {
+	}
+	throw std::runtime_error(std::format("invalid number '{}' for {}", itr->second, key));
+}
+
+std::string QueryServer::functionToJson(DartFnBase& fnBase)
+{
+	if (fnBase.IsStub()) {
+		return std::format("{{\"address\":{},\"size\":{},\"name\":{},\"stub\":true}}", fnBase.Address(), fnBase.Size(),
+			Util::JsonQuote(fnBase.FullName()));
+	}
+
+	auto& dartFn = *fnBase.AsFunction();
+	auto& cls = dartFn.Class();
+	return std::format("{{\"address\":{},\"size\":{},\"name\":{},\"full_name\":{},\"cid\":{},\"class\":{},\"library\":{},"
+		"\"function_kind\":{},\"static\":{},\"closure\":{},\"native\":{},\"stub\":false}}",
+		dartFn.Address(), dartFn.Size(), Util::JsonQuote(dartFn.Name()), Util::JsonQuote(dartFn.FullName()), cls.Id(),
+		Util::JsonQuote(cls.FullName()), Util::JsonQuote(cls.Library().url), (int)dartFn.Kind(), dartFn.IsStatic(),
+		dartFn.IsClosure(), dartFn.IsNative());
+}
+
+std::string QueryServer::classToJson(DartClass& cls)
+{
+	auto res = std::format("{{\"cid\":{},\"name\":{},\"library\":{},\"parent_cid\":{},\"size\":{},\"type_args_offset\":{},\"fields\":[",
+		cls.Id(), Util::JsonQuote(cls.FullName()), Util::JsonQuote(cls.Library().url),
+		cls.Parent() ? std::to_string(cls.Parent()->Id()) : "null", cls.Size(), cls.TypeArgumentsOffset());
+	bool first = true;
+	for (auto field : cls.Fields()) {
+		res += std::format("{}{{\"name\":{},\"type\":{},\"offset\":{},\"static\":{}}}", first ? "" : ",", Util::JsonQuote(field->Name()),
+			field->Type() ? Util::JsonQuote(field->Type()->ToString()) : "null", field->Offset(), field->IsStatic());
+		first = false;
+	}
+	res += "],\"functions\":[";
+	first = true;
+	for (auto dartFn : cls.Functions()) {
+		res += std::format("{}{{\"address\":{},\"name\":{}}}", first ? "" : ",", dartFn->Address(), Util::JsonQuote(dartFn->Name()));
+		first = false;
+	}
+	res += "]}";
+	return res;
+}
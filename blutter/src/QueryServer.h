@@ -0,0 +1,64 @@
+#pragma once
+#include "DartDumper.h"
+#include <unordered_map>
+
+class CodeAnalyzer;
+
+// Answers queries about a loaded app with JSON lines. The app is loaded only once, then many queries can be made by other tools.
+// A request is a JSON object (one per line) with string/number values only. "id" is copied to the response as it is.
+//   {"id":1,"cmd":"function","addr":"0x1234"}      function or stub containing the address (offset from libapp base)
+//   {"id":2,"cmd":"function","name":"Foo::bar"}    functions with the name or full name
+//   {"id":3,"cmd":"asm","addr":"0x1234"}           assembly with IL of a function (same as asm folder)
+//   {"id":4,"cmd":"il","addr":"0x1234"}            IL instructions of a function
+//   {"id":5,"cmd":"pool","offset":"0x10"}          Object Pool entry at the offset (same offset as in code)
+//   {"id":6,"cmd":"class","name":"Foo"}            class layout (or "cid" for class id)
+//   {"id":7,"cmd":"xrefs","addr":"0x1234"}         call sites of a function in app code (not dart: libraries)
+//   {"cmd":"quit"}
+// A function is identified by "addr" or "name" (must be unique). A response is
+//   {"id":1,"ok":true,"result":...} or {"id":1,"ok":false,"error":"message"}
+// Functions are analyzed when they are queried first. Analysis results, the name index and the xref index are kept for later queries.
+class QueryServer
+{
+public:
+	// analyzer can be nullptr when code analysis is not built
+	QueryServer(DartApp& app, DartDumper& dumper, CodeAnalyzer* analyzer) : app(app), dumper(dumper), analyzer(analyzer) {}
+	QueryServer() = delete;
+	QueryServer(const QueryServer&) = delete;
+	QueryServer(QueryServer&&) = delete;
+	QueryServer& operator=(const QueryServer&) = delete;
+
+	// must be in DartApp scope. returns when "quit" is received or at the end of input.
+	void Run(std::istream& in, std::ostream& out);
+
+private:
+	using Request = std::unordered_map<std::string, std::string>;
+
+	// returns JSON value of the result. throws std::runtime_error for a bad request.
+	std::string handle(const Request& req);
+
+	std::string queryFunction(const Request& req);
+	std::string queryAsm(const Request& req);
+	std::string queryIL(const Request& req);
+	std::string queryPool(const Request& req);
+	std::string queryClass(const Request& req);
+	std::string queryXrefs(const Request& req);
+
+	DartFunction& findFunction(const Request& req);
+	void ensureAnalyzed(DartFunction& dartFn);
+	void buildNameIndex();
+	void buildXrefIndex();
+
+	static Request parseRequest(const std::string& line);
+	static uint64_t getNumber(const Request& req, const char* key);
+	static std::string functionToJson(DartFnBase& fnBase);
+	static std::string classToJson(DartClass& cls);
+
+	DartApp& app;
+	DartDumper& dumper;
+	CodeAnalyzer* analyzer;
+
+	std::unordered_multimap<std::string, DartFunction*> nameIndex;
+	// map from function address to call sites (call address, caller)
+	std::unordered_map<uint64_t, std::vector<std::pair<uint64_t, DartFunction*>>> xrefIndex;
+	bool hasXrefIndex{ false };
+};
@@ -0,0 +1,82 @@
+#include "pch.h"
+#include "SymbolIndex.h"
+#include "DartApp.h"
+#include <fstream>
+
+void SymbolIndex::Write(DartApp& app, const std::filesystem::path& path)
+{
+	std::string strData;
+	std::unordered_map<std::string, uint32_t> strOffsets;
+	auto addString = [&](const std::string& s) {
+		auto [itr, inserted] = strOffsets.try_emplace(s, (uint32_t)strData.size());
+		if (inserted) {
+			strData += s;
+			strData += '\0';
+		}
+		return itr->second;
+	};
+
+	std::vector<SymbolIndexFormat::Entry> entries;
+	entries.reserve(app.AddressIndex().Size());
+	// stubs in address index might be split. get stubs from app instead.
+	for (const auto& indexEntry : app.AddressIndex().Entries()) {
+		if (indexEntry.fn->IsStub())
+			continue;
+		auto dartFn = indexEntry.fn->AsFunction();
+		uint16_t flags = 0;
+		if (dartFn->IsClosure())
+			flags |= SymbolIndexFormat::Entry::Closure;
+		if (dartFn->IsStatic())
+			flags |= SymbolIndexFormat::Entry::Static;
+		if (dartFn->IsNative())
+			flags |= SymbolIndexFormat::Entry::Native;
+		entries.push_back(SymbolIndexFormat::Entry{
+			.addr = dartFn->Address(),
+			.size = (uint32_t)dartFn->Size(),
+			.name = addString(dartFn->Name()),
+			.className = addString(dartFn->Class().Name()),
+			.libraryUrl = addString(dartFn->Class().Library().url),
+			.stubKind = SymbolIndexFormat::NoString,
+			.flags = flags,
+		});
+	}
+	for (auto stub : app.Stubs()) {
+		entries.push_back(SymbolIndexFormat::Entry{
+			.addr = stub->Address(),
+			.size = (uint32_t)stub->Size(),
+			.name = addString(stub->FullName()),
+			.className = SymbolIndexFormat::NoString,
+			.libraryUrl = SymbolIndexFormat::NoString,
+			.stubKind = addString(DartStub::KindName(stub->kind)),
+			.flags = SymbolIndexFormat::Entry::Stub,
+		});
+	}
+	std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.addr < b.addr; });
+
+	SymbolIndexFormat::Header header{
+		.version = SymbolIndexFormat::Version,
+		.numEntries = (uint32_t)entries.size(),
+		.entriesOffset = (uint32_t)sizeof(SymbolIndexFormat::Header),
+		.stringsOffset = (uint32_t)(sizeof(SymbolIndexFormat::Header) + entries.size() * sizeof(SymbolIndexFormat::Entry)),
+		.stringsSize = (uint32_t)strData.size(),
+	};
+	memcpy(header.magic, SymbolIndexFormat::Magic, sizeof(header.magic));
+
+	// write to temporary file first. a truncated index is never left for symbolizers that trust the header.
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream of{ tmpPath, std::ios::binary };
+		if (!of)
+			throw std::runtime_error(std::format("Cannot create symbol index file {}", tmpPath.string()));
+		of.write((const char*)&header, sizeof(header));
+		of.write((const char*)entries.data(), entries.size() * sizeof(SymbolIndexFormat::Entry));
+		of.write(strData.data(), strData.size());
+		if (!of.flush()) {
+			of.close();
+			std::filesystem::remove(tmpPath);
+			throw std::runtime_error(std::format("Cannot write symbol index file {}", tmpPath.string()));
+		}
+	}
+	std::filesystem::rename(tmpPath, path);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <filesystem>
+
+class DartApp;
+
+// Symbol index file format (blutter_symbols.idx) for looking up a function from an address without parsing.
+// All values are little endian. The file is
+//   Header, Entry[numEntries] sorted by address, string data (null terminated UTF-8 strings)
+// Strings are referred by offset in the string data. NoString is used for nothing.
+// A tool can mmap the file then binary search the entries. An address is in an entry if addr <= address < addr + size.
+// Addresses are offsets from the libapp base.
+namespace SymbolIndexFormat {
+	constexpr char Magic[8] = { 'B', 'L', 'U', 'T', 'S', 'Y', 'M', 'S' };
+	constexpr uint32_t Version = 1;
+	constexpr uint32_t NoString = 0xffffffff;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t numEntries;
+		uint32_t entriesOffset; // from start of file
+		uint32_t stringsOffset; // from start of file
+		uint32_t stringsSize;
+		uint32_t reserved;
+	};
+	static_assert(sizeof(Header) == 32);
+
+	struct Entry {
+		enum Flags : uint16_t {
+			Stub = 1,
+			Closure = 2,
+			Static = 4,
+			Native = 8,
+		};
+		uint64_t addr;
+		uint32_t size;
+		uint32_t name;
+		uint32_t className; // NoString for stub
+		uint32_t libraryUrl; // NoString for stub
+		uint32_t stubKind; // name of DartStub::Kind. NoString for function
+		uint16_t flags;
+		uint16_t reserved;
+	};
+	static_assert(sizeof(Entry) == 32);
+}
+
+class SymbolIndex final
+{
+public:
+	// write all functions and stubs (including split stubs) of the app
+	static void Write(DartApp& app, const std::filesystem::path& path);
+
+private:
+	SymbolIndex() = delete;
+};
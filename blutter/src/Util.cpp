@@ -2,6 +2,15 @@
 #include "Util.h"
 #include <sstream>
 #include <iomanip>
+#if defined(_WIN32) || defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
 // only ascii and no \0
 static void unescape_char(std::string& s, char c)
@@ -69,4 +78,91 @@ std::string Util::Unquote(const std::string& s)
 	std::istringstream ss(s);
 	ss >> std::quoted(result);
 	return result;
-}
\ No newline at end of file
+}
+
+std::string Util::JsonQuote(const std::string& s)
+{
+	std::string res;
+	res.reserve(s.length() + 2);
+	res += '"';
+	for (char c : s) {
+		switch (c) {
+		case '"': res += "\\\""; break;
+		case '\\': res += "\\\\"; break;
+		case '\n': res += "\\n"; break;
+		case '\r': res += "\\r"; break;
+		case '\t': res += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+				res += std::format("\\u{:04x}", (int)c);
+			else
+				res += c;
+			break;
+		}
+	}
+	res += '"';
+	return res;
+}
+
+#ifdef _WIN32
+// quote an argument for CommandLineToArgvW() rules. backslashes are special only before a quote.
+static void appendWinArg(std::string& cmd, const std::string& arg)
+{
+	if (!arg.empty() && arg.find_first_of(" \t\n\v\"") == std::string::npos) {
+		cmd += arg;
+		return;
+	}
+	cmd += '"';
+	for (auto it = arg.begin(); ; ++it) {
+		size_t numBackslashes = 0;
+		while (it != arg.end() && *it == '\\') {
+			++it;
+			++numBackslashes;
+		}
+		if (it == arg.end()) {
+			cmd.append(numBackslashes * 2, '\\');
+			break;
+		}
+		cmd.append(*it == '"' ? numBackslashes * 2 + 1 : numBackslashes, '\\');
+		cmd += *it;
+	}
+	cmd += '"';
+}
+
+int Util::RunProcess(const std::vector<std::string>& args)
+{
+	std::string cmd;
+	for (const auto& arg : args) {
+		if (!cmd.empty())
+			cmd += ' ';
+		appendWinArg(cmd, arg);
+	}
+	STARTUPINFOA si{ .cb = sizeof(STARTUPINFOA) };
+	PROCESS_INFORMATION pi{};
+	if (!CreateProcessA(nullptr, cmd.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &si, &pi))
+		return -1;
+	WaitForSingleObject(pi.hProcess, INFINITE);
+	DWORD exitCode = (DWORD)-1;
+	GetExitCodeProcess(pi.hProcess, &exitCode);
+	CloseHandle(pi.hThread);
+	CloseHandle(pi.hProcess);
+	return (int)exitCode;
+}
+#else
+int Util::RunProcess(const std::vector<std::string>& args)
+{
+	std::vector<char*> argv;
+	for (const auto& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+	pid_t pid;
+	if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+		return -1;
+	int status;
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno != EINTR)
+			return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
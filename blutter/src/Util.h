@@ -7,5 +7,10 @@ public:
 	static std::string UnescapeWithQuote(const char* s);
 	static std::string Quote(const std::string& s);
 	static std::string Unquote(const std::string& s);
+	// quoted JSON string (s is UTF-8)
+	static std::string JsonQuote(const std::string& s);
+	// run a program with the arguments (args[0] is the program, searched in PATH if it has no directory) without a shell and wait for it.
+	// returns the exit code or -1 if the program cannot be started or does not exit normally.
+	static int RunProcess(const std::vector<std::string>& args);
 };
 
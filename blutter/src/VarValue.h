@@ -1,4 +1,5 @@
 #pragma once
+#include "Arena.h"
 #include "DartClass.h"
 #include "DartStub.h"
 #include "Util.h"
@@ -72,6 +73,9 @@ struct VarValue {
 	VarValue(ValueType typeId, bool hasValue = false) : typeId(typeId), hasValue(hasValue) {}
 	//VarValue() : kind(Unknown), hasValue(false) {}
 	virtual ~VarValue() {}
+	// values are allocated in the arena of analyzing function (Arena::Scope)
+	static void* operator new(size_t size) { return Arena::AllocateScoped(size); }
+	static void operator delete(void* p) { Arena::FreeScoped(p); }
 	//virtual std::string ToString() = 0;
 	virtual std::string ToString() { return "unknown"; }
 	bool HasValue() const { return hasValue; }
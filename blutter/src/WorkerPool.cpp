@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "WorkerPool.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+static std::atomic<int64_t> workerZoneBytes{ 0 };
+
+void WorkerPool::ParallelFor(unsigned numJobs, size_t count, const std::function<void(unsigned, size_t)>& fn)
+{
+	if (numJobs > count)
+		numJobs = (unsigned)count;
+
+	if (numJobs <= 1) {
+		for (size_t i = 0; i < count; i++)
+			fn(0, i);
+		return;
+	}
+
+	auto ig = dart::IsolateGroup::Current();
+	ASSERT(ig != nullptr);
+
+	std::atomic<size_t> nextIdx{ 0 };
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	auto worker = [&](unsigned workerId) {
+		// helper threads do not take part in safepoint operations. no GC while blutter is running.
+		const bool kBypassSafepoint = true;
+		dart::Thread::EnterIsolateGroupAsHelper(ig, dart::Thread::kCompilerTask, kBypassSafepoint);
+		{
+			auto thread = dart::Thread::Current();
+			dart::StackZone zone(thread);
+			dart::HandleScope scope(thread);
+			try {
+				size_t idx;
+				while ((idx = nextIdx.fetch_add(1)) < count)
+					fn(workerId, idx);
+			}
+			catch (...) {
+				std::lock_guard lock(errorMutex);
+				if (!error)
+					error = std::current_exception();
+				// stop other workers from taking more tasks
+				nextIdx = count;
+			}
+			workerZoneBytes += zone.GetZone()->SizeInBytes();
+		}
+		dart::Thread::ExitIsolateGroupAsHelper(kBypassSafepoint);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(numJobs);
+	for (unsigned i = 0; i < numJobs; i++)
+		threads.emplace_back(worker, i);
+	for (auto& t : threads)
+		t.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+unsigned WorkerPool::DefaultJobs()
+{
+	const auto n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+int64_t WorkerPool::ZoneBytes()
+{
+	return workerZoneBytes;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <functional>
+#include <cstdint>
+
+// Runs independent tasks (per function or per library) on multiple threads.
+// Every worker thread is attached to current isolate group with its own zone, so the tasks can create Dart handles.
+class WorkerPool final
+{
+public:
+	// call fn(workerId, idx) for every idx in [0, count). workerId is in [0, numJobs).
+	// the indices are taken in order from a shared counter, a worker that finishes early just takes the next index.
+	// if numJobs <= 1, everything is run on the calling thread in order.
+	// the first exception thrown from fn is rethrown on the calling thread after all workers stop.
+	static void ParallelFor(unsigned numJobs, size_t count, const std::function<void(unsigned, size_t)>& fn);
+
+	// number of jobs for "--jobs 0"
+	static unsigned DefaultJobs();
+
+	// total bytes allocated in zones of all finished worker threads
+	static int64_t ZoneBytes();
+
+private:
+	WorkerPool() = delete;
+};
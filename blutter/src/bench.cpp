@@ -0,0 +1,241 @@
+#include "pch.h"
+#include "DartApp.h"
+#include "DartDumper.h"
+#include "CodeAnalyzer.h"
+#include "ElfHelper.h"
+#include "PhaseStats.h"
+#include "WorkerPool.h"
+#include "args.hxx"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+
+// Benchmark harness for the blutter pipeline.
+// Each stage is run many times against every libapp fixture, then median/p95 latency and throughput are reported.
+//
+// Dart VM can be initialized only once per process. So each fixture is run in its own child process
+// (the harness runs itself with only one fixture) and DartApp construction and LoadInfo are measured once per process.
+
+struct StageResult {
+	std::string name;
+	std::vector<double> samples; // seconds
+	uint64_t items{ 0 }; // items processed per run (functions, instructions, bytes written)
+	const char* itemUnit{ "" };
+	uint64_t items2{ 0 };
+	const char* itemUnit2{ "" };
+};
+
+static double percentile(std::vector<double> samples, double p)
+{
+	std::sort(samples.begin(), samples.end());
+	auto idx = (size_t)(p * samples.size() + 0.999999);
+	if (idx > 0)
+		idx--;
+	return samples[std::min(idx, samples.size() - 1)];
+}
+
+static double median(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	const auto n = samples.size();
+	return n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+}
+
+template <typename Fn>
+static double measure(Fn&& fn)
+{
+	const auto start = std::chrono::steady_clock::now();
+	fn();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string formatThroughput(uint64_t items, const char* unit, double seconds)
+{
+	if (items == 0 || seconds <= 0)
+		return "";
+	if (std::string_view{ unit } == "MB")
+		return std::format("{:.2f} MB/s", items / seconds / (1024 * 1024));
+	return std::format("{:.0f} {}/s", items / seconds, unit);
+}
+
+static void printResults(const std::string& fixture, const std::vector<StageResult>& results)
+{
+	std::cout << std::format("fixture: {}\n", fixture);
+	std::cout << std::format("  {:<16} {:>5} {:>12} {:>12}  {}\n", "stage", "runs", "median(ms)", "p95(ms)", "throughput (median)");
+	for (const auto& res : results) {
+		if (res.samples.empty())
+			continue;
+		const auto med = median(res.samples);
+		auto throughput = formatThroughput(res.items, res.itemUnit, med);
+		const auto throughput2 = formatThroughput(res.items2, res.itemUnit2, med);
+		if (!throughput2.empty())
+			throughput += ", " + throughput2;
+		std::cout << std::format("  {:<16} {:>5} {:>12.3f} {:>12.3f}  {}\n", res.name, res.samples.size(),
+			med * 1000, percentile(res.samples, 0.95) * 1000, throughput);
+	}
+	std::cout << std::format("  peak RSS: {} MB\n", PhaseStats::PeakRss() / (1024 * 1024));
+	std::cout << std::flush;
+}
+
+static void benchFixture(const std::string& path, int iterations, unsigned numJobs, const std::filesystem::path& outDir)
+{
+	std::vector<StageResult> results;
+
+	{
+		StageResult res{ .name = "ElfMapping", .itemUnit = "MB" };
+		for (int i = 0; i < iterations; i++) {
+			LibAppInfo libInfo;
+			res.samples.push_back(measure([&] { libInfo = ElfHelper::MapLibAppSo(path.c_str()); }));
+			res.items = libInfo.size;
+			ElfHelper::UnmapLibAppSo(libInfo);
+		}
+		results.push_back(std::move(res));
+	}
+
+	StageResult loadRes{ .name = "Load" };
+	std::unique_ptr<DartApp> app;
+	loadRes.samples.push_back(measure([&] { app = std::make_unique<DartApp>(path.c_str()); }));
+	results.push_back(std::move(loadRes));
+
+	app->EnterScope();
+	StageResult loadInfoRes{ .name = "LoadInfo", .itemUnit = "functions" };
+	loadInfoRes.samples.push_back(measure([&] { app->LoadInfo(); }));
+	loadInfoRes.items = app->NumFunctions();
+	results.push_back(std::move(loadInfoRes));
+	app->ExitScope();
+
+	app->EnterScope();
+#ifndef NO_CODE_ANALYSIS
+	{
+		StageResult res{ .name = "AnalyzeAll", .itemUnit = "functions", .itemUnit2 = "instructions" };
+		for (int i = 0; i < iterations; i++) {
+			if (i != 0) {
+				// drop previous result. analysis data can be set only once per function
+				app->ReleaseAnalyzedData();
+			}
+			CodeAnalyzer analyzer{ *app, numJobs };
+			res.samples.push_back(measure([&] { analyzer.AnalyzeAll(); }));
+			res.items = analyzer.NumAnalyzedFunctions();
+			res.items2 = analyzer.NumInstructions();
+		}
+		results.push_back(std::move(res));
+	}
+#endif
+
+	{
+		StageResult poolRes{ .name = "DumpObjectPool", .itemUnit = "MB" };
+		StageResult objsRes{ .name = "DumpObjects", .itemUnit = "MB" };
+		StageResult codeRes{ .name = "DumpCode", .itemUnit = "MB" };
+		StageResult idaRes{ .name = "Dump4Ida", .itemUnit = "MB" };
+		for (int i = 0; i < iterations; i++) {
+			std::filesystem::remove_all(outDir);
+			std::filesystem::create_directories(outDir);
+			DartDumper dumper{ *app, numJobs };
+			poolRes.samples.push_back(measure([&] { dumper.DumpObjectPool((outDir / "pp.txt").string().c_str()); }));
+			poolRes.items = PhaseStats::OutputSize(outDir / "pp.txt");
+			objsRes.samples.push_back(measure([&] { dumper.DumpObjects((outDir / "objs.txt").string().c_str()); }));
+			objsRes.items = PhaseStats::OutputSize(outDir / "objs.txt");
+			codeRes.samples.push_back(measure([&] { dumper.DumpCode((outDir / "asm").string().c_str()); }));
+			codeRes.items = PhaseStats::OutputSize(outDir / "asm");
+			idaRes.samples.push_back(measure([&] { dumper.Dump4Ida(outDir / "ida_script"); }));
+			idaRes.items = PhaseStats::OutputSize(outDir / "ida_script");
+		}
+		results.push_back(std::move(poolRes));
+		results.push_back(std::move(objsRes));
+		results.push_back(std::move(codeRes));
+		results.push_back(std::move(idaRes));
+	}
+	app->ExitScope();
+
+	printResults(path, results);
+}
+
+static std::vector<std::string> collectFixtures(const std::vector<std::string>& inputs)
+{
+	std::vector<std::string> fixtures;
+	for (const auto& input : inputs) {
+		if (std::filesystem::is_directory(input)) {
+			std::vector<std::string> files;
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(input)) {
+				if (entry.is_regular_file() && entry.path().extension() == ".so")
+					files.push_back(entry.path().string());
+			}
+			std::sort(files.begin(), files.end());
+			fixtures.insert(fixtures.end(), files.begin(), files.end());
+		}
+		else {
+			fixtures.push_back(input);
+		}
+	}
+	return fixtures;
+}
+
+static std::string quoteArg(const std::string& arg)
+{
+	return '"' + arg + '"';
+}
+
+int main(int argc, char** argv)
+{
+	args::ArgumentParser parser("Blutter benchmark - measure each stage of blutter against libapp fixtures", "");
+	args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
+	args::ValueFlagList<std::string> inputs(parser, "corpus", "libapp file or directory of libapp files (*.so)", { 'i', "in" }, {}, args::Options::Required);
+	args::ValueFlag<std::string> outdir(parser, "outdir", "scratch directory for dumper output", { 'o', "out" });
+	args::ValueFlag<int> iterations(parser, "iterations", "number of runs for each stage", { 'n', "iterations" }, 10);
+	args::ValueFlag<unsigned> jobs(parser, "jobs", "number of threads for code analysis and dumping code (0 for all cores)", { 'j', "jobs" }, 1);
+
+	try {
+		parser.ParseCLI(argc, argv);
+
+		const auto fixtures = collectFixtures(args::get(inputs));
+		if (fixtures.empty()) {
+			std::cerr << "No libapp fixture is found\n";
+			return 1;
+		}
+		const auto numIterations = std::max(args::get(iterations), 1);
+		std::filesystem::path outDir = outdir ? std::filesystem::path{ args::get(outdir) } : std::filesystem::temp_directory_path() / "blutter_bench";
+
+		if (fixtures.size() == 1) {
+			const auto numJobs = args::get(jobs) == 0 ? WorkerPool::DefaultJobs() : args::get(jobs);
+			benchFixture(fixtures[0], numIterations, numJobs, outDir);
+			std::filesystem::remove_all(outDir);
+			return 0;
+		}
+
+		// one process per fixture
+		int failed = 0;
+		for (const auto& fixture : fixtures) {
+			auto cmd = std::format("{} -i {} -o {} -n {} -j {}", quoteArg(argv[0]), quoteArg(fixture), quoteArg(outDir.string()),
+				numIterations, args::get(jobs));
+#ifdef _WIN32
+			// cmd.exe strips the first and last quotes
+			cmd = '"' + cmd + '"';
+#endif
+			if (std::system(cmd.c_str()) != 0) {
+				std::cerr << "Benchmark failed for " << fixture << "\n";
+				failed++;
+			}
+		}
+		return failed ? 1 : 0;
+	}
+	catch (args::Help&) {
+		std::cout << parser;
+		return 0;
+	}
+	catch (args::ParseError& e) {
+		std::cerr << e.what() << "\n";
+		std::cerr << parser;
+		return 1;
+	}
+	catch (args::ValidationError& e) {
+		std::cerr << e.what() << "\n";
+		std::cerr << parser;
+		return 1;
+	}
+	catch (std::exception& e) {
+		std::cerr << "exception: " << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
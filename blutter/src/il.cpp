@@ -13,4 +13,24 @@ std::string CallLeafRuntimeInstr::ToString()
 	const auto& name = GetThreadOffsetName(thrOffset);
 	const auto info = GetThreadLeafFunction(thrOffset);
 	return std::format("CallRuntime_{}({}) -> {}", name, info->params, info->returnType);
-}
\ No newline at end of file
+}
+
+void ILStream::Add(ILInstr::ILKind kind, AddrRange range, std::string_view text)
+{
+	ASSERT(range.start >= baseAddr);
+	starts.push_back((uint32_t)(range.start - baseAddr));
+	ends.push_back((uint32_t)(range.end - baseAddr));
+	kinds.push_back((uint8_t)kind);
+	texts += text;
+	textOffsets.push_back((uint32_t)texts.size());
+}
+
+void ILStream::Reserve(size_t count)
+{
+	starts.reserve(count);
+	ends.reserve(count);
+	kinds.reserve(count);
+	textOffsets.reserve(count + 1);
+	// most IL texts are short
+	texts.reserve(count * 32);
+}
@@ -41,12 +41,16 @@ public:
 		StoreStaticField,
 		WriteBarrier,
 		TestType,
+		StoreObjectPool,
 	};
 
 	ILInstr(const ILInstr&) = delete;
 	ILInstr(ILInstr&&) = delete;
 	ILInstr& operator=(const ILInstr&) = delete;
 	virtual ~ILInstr() {}
+	// ILs are allocated in the arena of analyzing function (Arena::Scope)
+	static void* operator new(size_t size) { return Arena::AllocateScoped(size); }
+	static void operator delete(void* p) { Arena::FreeScoped(p); }
 
 	virtual std::string ToString() = 0;
 	ILKind Kind() const { return kind; }
@@ -185,7 +189,7 @@ public:
 
 class StoreObjectPoolInstr : public ILInstr {
 public:
-	StoreObjectPoolInstr(AddrRange addrRange, A64::Register srcReg, int64_t offset) : ILInstr(LoadValue, addrRange), srcReg(srcReg), offset(offset) {}
+	StoreObjectPoolInstr(AddrRange addrRange, A64::Register srcReg, int64_t offset) : ILInstr(StoreObjectPool, addrRange), srcReg(srcReg), offset(offset) {}
 	StoreObjectPoolInstr() = delete;
 	StoreObjectPoolInstr(StoreObjectPoolInstr&&) = delete;
 	StoreObjectPoolInstr& operator=(const StoreObjectPoolInstr&) = delete;
@@ -585,7 +589,7 @@ protected:
 class StoreStaticFieldInstr : public ILInstr {
 public:
 	StoreStaticFieldInstr(AddrRange addrRange, A64::Register valReg, uint32_t fieldOffset)
-		: ILInstr(LoadStaticField, addrRange), valReg(valReg), fieldOffset(fieldOffset) {}
+		: ILInstr(StoreStaticField, addrRange), valReg(valReg), fieldOffset(fieldOffset) {}
 	StoreStaticFieldInstr() = delete;
 	StoreStaticFieldInstr(StoreStaticFieldInstr&&) = delete;
 	StoreStaticFieldInstr& operator=(const StoreStaticFieldInstr&) = delete;
@@ -630,4 +634,56 @@ public:
 
 	A64::Register srcReg;
 	std::string typeName;
-};
\ No newline at end of file
+};
+
+// Compact IL of an analyzed function for dumping. ILInstr objects are needed only while analyzing.
+// When analysis is finished (or restored from cache), every IL is rendered once into a struct of arrays,
+// so dumping walks contiguous arrays instead of chasing a pointer and calling ToString() per IL.
+class ILStream {
+public:
+	explicit ILStream(uint64_t baseAddr) : baseAddr(baseAddr) { textOffsets.push_back(0); }
+	ILStream() = delete;
+	ILStream(const ILStream&) = delete;
+	ILStream(ILStream&&) = delete;
+	ILStream& operator=(const ILStream&) = delete;
+
+	struct Entry {
+		ILInstr::ILKind kind;
+		AddrRange range;
+		std::string_view text;
+	};
+
+	// ILs are added in the order of analysis (by address)
+	void Add(ILInstr::ILKind kind, AddrRange range, std::string_view text);
+	void Reserve(size_t count);
+	// bytes used by the arrays
+	size_t MemorySize() const {
+		return (starts.capacity() + ends.capacity() + textOffsets.capacity()) * sizeof(uint32_t) + kinds.capacity() + texts.capacity();
+	}
+
+	size_t Size() const { return kinds.size(); }
+	bool Empty() const { return kinds.empty(); }
+	ILInstr::ILKind Kind(size_t i) const { return (ILInstr::ILKind)kinds[i]; }
+	uint64_t Start(size_t i) const { return baseAddr + starts[i]; }
+	uint64_t End(size_t i) const { return baseAddr + ends[i]; }
+	AddrRange Range(size_t i) const { return AddrRange{ Start(i), End(i) }; }
+	std::string_view Text(size_t i) const { return std::string_view{ texts }.substr(textOffsets[i], textOffsets[i + 1] - textOffsets[i]); }
+	Entry operator[](size_t i) const { return Entry{ Kind(i), Range(i), Text(i) }; }
+
+	// call fn(const Entry&) for every IL in address order
+	template <typename F>
+	void ForEach(F&& fn) const {
+		for (size_t i = 0; i < kinds.size(); i++)
+			fn((*this)[i]);
+	}
+
+private:
+	uint64_t baseAddr;
+	// addresses are offsets from the function address
+	std::vector<uint32_t> starts;
+	std::vector<uint32_t> ends;
+	std::vector<uint8_t> kinds;
+	// text of IL i is texts[textOffsets[i]:textOffsets[i+1]]
+	std::vector<uint32_t> textOffsets;
+	std::string texts;
+};
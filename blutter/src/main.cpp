@@ -1,10 +1,157 @@
 #include "pch.h"
+#include "AnalysisCache.h"
+#include "AppFingerprint.h"
 #include "DartApp.h"
 #include "DartDumper.h"
+#include "DartLoader.h"
 #include "CodeAnalyzer.h"
+#include "CodeFilter.h"
 #include "FridaWriter.h"
+#include "ModelExporter.h"
+#include "QueryServer.h"
+#include "WorkerPool.h"
+#include "PhaseStats.h"
+#include "SymbolIndex.h"
+#include "Util.h"
 #include "args.hxx"
 #include <filesystem>
+#include <fstream>
+#include <future>
+
+#ifndef NO_CODE_ANALYSIS
+static void addAnalyzerCounts(PhaseStats& stats, const CodeAnalyzer& analyzer)
+{
+	stats.AddCount("functions", analyzer.NumAnalyzedFunctions());
+	stats.AddCount("instructions", analyzer.NumInstructions());
+	stats.AddCount("il", analyzer.NumILs());
+	stats.AddCount("il.arena_bytes", analyzer.ILArenaBytes());
+	stats.AddCount("il.stream_bytes", analyzer.ILStreamBytes());
+	uint64_t matcherCalls = 0;
+	for (const auto& matcher : analyzer.MatcherStats()) {
+		stats.AddCount(std::format("matcher.{}.hits", matcher.name), matcher.hits);
+		stats.AddCount(std::format("matcher.{}.rejects", matcher.name), matcher.rejects);
+		matcherCalls += matcher.hits + matcher.rejects;
+	}
+	stats.AddCount("matcher_calls", matcherCalls);
+}
+
+static void saveCache(PhaseStats& stats, AnalysisCache* cache)
+{
+	if (!cache)
+		return;
+	std::cout << std::format("Analysis cache: {} hits, {} misses\n", cache->NumHits(), cache->NumMisses());
+	stats.AddCount("cache_hits", cache->NumHits());
+	stats.AddCount("cache_misses", cache->NumMisses());
+	cache->Save();
+}
+#endif
+
+struct DumpOptions {
+	unsigned numJobs;
+	bool streamMode;
+	std::string cacheDir; // empty for no analysis cache
+	std::string exportFormat; // empty for no export
+	unsigned maxElements;
+	size_t blobSize;
+	const CodeFilter* filter; // nullptr for all code
+};
+
+static void loadApp(DartApp& app, PhaseStats& stats)
+{
+	std::cout << std::format("libapp is loaded at {:#x}\n", app.base());
+	std::cout << std::format("Dart heap at {:#x}\n", app.heap_base());
+
+	app.EnterScope();
+	stats.Begin("LoadInfo");
+	app.LoadInfo();
+	stats.AddCount("libraries", app.NumLibraries());
+	stats.AddCount("functions", app.NumFunctions());
+	stats.AddCount("stubs", app.NumStubs());
+	stats.End();
+	app.ExitScope();
+}
+
+// analyze the app then write all output files (the default mode)
+static void dumpApp(DartApp& app, const std::filesystem::path& outDir, const DumpOptions& opts, PhaseStats& stats)
+{
+	app.EnterScope();
+#ifndef NO_CODE_ANALYSIS
+	CodeAnalyzer analyzer{ app, opts.numJobs };
+	if (opts.filter)
+		analyzer.SetFilter(opts.filter);
+	std::unique_ptr<AnalysisCache> cache;
+	if (!opts.cacheDir.empty()) {
+		cache = std::make_unique<AnalysisCache>(app, opts.cacheDir);
+		analyzer.SetCache(cache.get());
+	}
+	if (!opts.streamMode) {
+		std::cout << "Analyzing the application\n";
+		stats.Begin("AnalyzeAll");
+		analyzer.AnalyzeAll();
+		addAnalyzerCounts(stats, analyzer);
+		saveCache(stats, cache.get());
+		stats.End();
+	}
+#endif
+
+	DartDumper dumper{ app, opts.numJobs };
+	if (opts.filter)
+		dumper.SetFilter(opts.filter);
+	dumper.SetRenderLimits(opts.maxElements, opts.blobSize, outDir / "blobs");
+	std::cout << "Dumping Object Pool\n";
+	stats.Begin("DumpObjectPool", outDir / "pp.txt");
+	dumper.DumpObjectPool((outDir / "pp.txt").string().c_str());
+	stats.AddCount("pool_entries", app.GetObjectPool().Length());
+	stats.Begin("DumpObjects", outDir / "objs.txt");
+	dumper.DumpObjects((outDir / "objs.txt").string().c_str());
+#ifndef NO_CODE_ANALYSIS
+	if (opts.streamMode) {
+		std::cout << "Analyzing the application and generating application assemblies\n";
+		stats.Begin("AnalyzeAndDumpCode", outDir / "asm");
+		dumper.DumpCode((outDir / "asm").string().c_str(), &analyzer);
+		addAnalyzerCounts(stats, analyzer);
+		saveCache(stats, cache.get());
+	}
+	else {
+		std::cout << "Generating application assemblies\n";
+		stats.Begin("DumpCode", outDir / "asm");
+		dumper.DumpCode((outDir / "asm").string().c_str());
+	}
+#else
+	std::cout << "Generating application functions in asm folder\n";
+	stats.Begin("DumpCode", outDir / "asm");
+	dumper.DumpCode((outDir / "asm").string().c_str());
+#endif
+	stats.Begin("Dump4Ida", outDir / "ida_script");
+	dumper.Dump4Ida(outDir / "ida_script");
+	// stubs are split while analyzing and dumping code. write the index after them.
+	stats.Begin("SymbolIndex", outDir / "blutter_symbols.idx");
+	SymbolIndex::Write(app, outDir / "blutter_symbols.idx");
+	stats.End();
+
+	if (!opts.exportFormat.empty()) {
+		const auto& format = opts.exportFormat;
+		const auto modelPath = outDir / (format == "bin" ? "model.bin" : "model.jsonl");
+		std::cout << "Exporting analysis model\n";
+		stats.Begin("Export", modelPath);
+		ModelExporter exporter{ app, dumper };
+		exporter.Collect();
+		if (format == "bin")
+			exporter.WriteBinary(modelPath);
+		else
+			exporter.WriteJson(modelPath);
+		stats.AddCount("functions", exporter.NumFunctions());
+		stats.End();
+	}
+
+	std::cout << "Generating Frida script\n";
+	stats.Begin("FridaWriter", outDir / "blutter_frida.js");
+	FridaWriter fwriter{ app };
+	fwriter.Create((outDir / "blutter_frida.js").string().c_str());
+	stats.End();
+
+	app.ExitScope();
+}
 
 int main(int argc, char** argv)
 {
@@ -13,9 +160,40 @@ int main(int argc, char** argv)
 	args::Group reqGrp(parser, "Required arguments", args::Group::Validators::All);
 	args::ValueFlag<std::string> infile(reqGrp, "infile", "libapp file", { 'i', "in" });
 	args::ValueFlag<std::string> outdir(reqGrp, "outdir", "out path", { 'o', "out"});
+	args::ValueFlag<std::string> statsFile(parser, "stats", "write timing and memory usage of each phase to a JSON file", { "stats" });
+	args::Flag stream(parser, "stream", "analyze and dump code one library at a time. analysis result is freed after dumping a library to reduce memory usage", { "stream" });
+	args::ValueFlag<unsigned> jobs(parser, "jobs", "number of threads for code analysis and dumping code (0 for all cores)", { 'j', "jobs" }, 1);
+	args::ValueFlag<std::string> cacheDir(parser, "cachedir", "directory of analysis cache. functions that are not changed from previous run are not analyzed again", { "cache-dir" });
+	args::ValueFlag<std::string> diffWith(parser, "oldfile", "report added, removed and changed functions and classes from old libapp to diff.txt in out path (no dumping)", { "diff" });
+	args::ValueFlag<std::string> exportFormat(parser, "format", "also export the analysis model as 'bin' (model.bin) or 'json' (model.jsonl, one object per line). no IL and parameters in stream mode", { "export" });
+	args::ValueFlag<unsigned> maxElements(parser, "num", "render at most num elements of each TypedData, List, Map and Set in object dumps (0 for all)", { "max-elements" }, 0);
+	args::ValueFlag<size_t> blobSize(parser, "bytes", "write TypedData of at least bytes size to a file in blobs folder of out path instead of inline text", { "blob-size" }, 0);
+	args::ValueFlagList<std::string> includes(parser, "rule", "analyze and dump only code matched the rule (KIND=PATTERN, KIND is lib, class or fn, PATTERN is glob or /regex/)", { "include" });
+	args::ValueFlagList<std::string> excludes(parser, "rule", "do not analyze and dump code matched the rule (same format as --include)", { "exclude" });
+	args::ValueFlagList<std::string> addrRanges(parser, "range", "analyze and dump only functions with entry point in the range (START-END in hex offset from libapp base)", { "addr-range" });
+	args::Flag serve(parser, "serve", "load the app once then answer JSON-lines queries from stdin to stdout (see QueryServer.h). messages are written to stderr", { "serve" });
+	args::Flag batch(parser, "batch", "infile is a text file listing libapp files of same Dart version (one per line, optionally followed by a tab and output name). the Dart VM is initialized once and each app is dumped to its own folder in out path", { "batch" });
+	args::ValueFlag<std::string> fingerprintFile(parser, "fingerprint", "write fingerprints of functions and classes to a file (no dumping)", { "fingerprint" });
 
 	try {
 		parser.ParseCLI(argc, argv);
+		if (exportFormat && args::get(exportFormat) != "bin" && args::get(exportFormat) != "json")
+			throw args::ValidationError("export format must be 'bin' or 'json'");
+		if (batch && (serve || diffWith || fingerprintFile))
+			throw args::ValidationError("--batch cannot be used with --serve, --diff or --fingerprint");
+
+		CodeFilter filter;
+		for (const auto& rule : args::get(includes))
+			filter.AddInclude(rule);
+		for (const auto& rule : args::get(excludes))
+			filter.AddExclude(rule);
+		for (const auto& range : args::get(addrRanges))
+			filter.AddAddressRange(range);
+
+		// stdout is only for query responses in server mode
+		std::ostream serverOut{ std::cout.rdbuf() };
+		if (serve)
+			std::cout.rdbuf(std::cerr.rdbuf());
 
 		auto& libappPath = args::get(infile);
 
@@ -26,38 +204,136 @@ int main(int argc, char** argv)
 			return 1;
 		}
 
-		DartApp app{ libappPath.c_str() };
-		std::cout << std::format("libapp is loaded at {:#x}\n", app.base());
-		std::cout << std::format("Dart heap at {:#x}\n", app.heap_base());
+		const auto numJobs = args::get(jobs) == 0 ? WorkerPool::DefaultJobs() : args::get(jobs);
+		const DumpOptions dumpOpts{
+			.numJobs = numJobs,
+			.streamMode = stream,
+			.cacheDir = cacheDir ? args::get(cacheDir) : "",
+			.exportFormat = exportFormat ? args::get(exportFormat) : "",
+			.maxElements = args::get(maxElements),
+			.blobSize = args::get(blobSize),
+			.filter = filter.Empty() ? nullptr : &filter,
+		};
 
-		app.EnterScope();
-		app.LoadInfo();
-		app.ExitScope();
+		if (batch) {
+			std::ifstream listFile{ libappPath };
+			if (!listFile)
+				throw std::runtime_error(std::format("Cannot open batch list file {}", libappPath));
+			// the VM snapshot of first app is used for all apps. it is same for same Dart version.
+			DartLoader::SetKeepVM(true);
+			std::string line;
+			unsigned appNo = 0, numFailed = 0;
+			while (std::getline(listFile, line)) {
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (line.empty())
+					continue;
+				appNo++;
+				const auto tabPos = line.find('\t');
+				const auto appPath = line.substr(0, tabPos);
+				const auto appOutDir = outDir / (tabPos != std::string::npos ? line.substr(tabPos + 1) : std::format("{:04}", appNo));
+				std::cout << std::format("[{}] {} -> {}\n", appNo, appPath, appOutDir.string());
+				try {
+					std::filesystem::create_directories(appOutDir);
+					PhaseStats stats;
+					stats.Begin("Load");
+					DartApp app{ appPath.c_str() };
+					stats.End();
+					loadApp(app, stats);
+					dumpApp(app, appOutDir, dumpOpts, stats);
+					if (statsFile)
+						stats.WriteJson(appOutDir / std::filesystem::path(args::get(statsFile)).filename());
+				}
+				catch (std::exception& e) {
+					// an app that cannot be loaded (e.g. different Dart version) does not stop the batch
+					std::cerr << std::format("[{}] failed: {}\n", appNo, e.what());
+					numFailed++;
+				}
+			}
+			DartLoader::Cleanup();
+			std::cout << std::format("Batch done: {} apps, {} failed\n", appNo, numFailed);
+			return numFailed == 0 ? 0 : 1;
+		}
 
-		app.EnterScope();
-#ifndef NO_CODE_ANALYSIS
-		std::cout << "Analyzing the application\n";
-		CodeAnalyzer analyzer{ app };
-		analyzer.AnalyzeAll();
-#endif
+		// Dart VM can be loaded only once per process. the old libapp is fingerprinted by another blutter process.
+		const auto oldFingerprintPath = outDir / "old_fingerprint.txt";
+		std::future<int> oldFingerprintResult;
+		// both processes run at the same time. the threads are split between them.
+		const auto oldFingerprintJobs = diffWith ? std::max(1u, numJobs / 2) : 0u;
+		const auto fingerprintJobs = std::max(1u, numJobs - oldFingerprintJobs);
+		if (diffWith) {
+			// no shell. the paths are passed as they are.
+			std::vector<std::string> childArgs{ argv[0], "-i", args::get(diffWith), "-o", outDir.string(),
+				"-j", std::to_string(oldFingerprintJobs), "--fingerprint", oldFingerprintPath.string() };
+			oldFingerprintResult = std::async(std::launch::async, [childArgs] { return Util::RunProcess(childArgs); });
+		}
 
-		DartDumper dumper{ app };
-		std::cout << "Dumping Object Pool\n";
-		dumper.DumpObjectPool((outDir / "pp.txt").string().c_str());
-		dumper.DumpObjects((outDir / "objs.txt").string().c_str());
+		PhaseStats stats;
+		stats.Begin("Load");
+		DartApp app{ libappPath.c_str() };
+		stats.End();
+		loadApp(app, stats);
+
+		if (serve) {
+			app.EnterScope();
 #ifndef NO_CODE_ANALYSIS
-		std::cout << "Generating application assemblies\n";
+			CodeAnalyzer analyzer{ app, numJobs };
+			if (!filter.Empty())
+				analyzer.SetFilter(&filter);
+			CodeAnalyzer* analyzerPtr = &analyzer;
 #else
-		std::cout << "Generating application functions in asm folder\n";
+			CodeAnalyzer* analyzerPtr = nullptr;
 #endif
-		dumper.DumpCode((outDir / "asm").string().c_str());
-		dumper.Dump4Ida(outDir / "ida_script");
+			DartDumper dumper{ app, numJobs };
+			dumper.SetRenderLimits(args::get(maxElements), args::get(blobSize), outDir / "blobs");
+			QueryServer server{ app, dumper, analyzerPtr };
+			std::cout << "Serving queries\n";
+			server.Run(std::cin, serverOut);
+			app.ExitScope();
+			return 0;
+		}
+
+		if (diffWith || fingerprintFile) {
+			app.EnterScope();
+			stats.Begin("Fingerprint");
+			AppFingerprint fingerprint{ app, fingerprintJobs };
+			stats.AddCount("functions", fingerprint.NumFunctions());
+			stats.AddCount("classes", fingerprint.NumClasses());
+			stats.End();
+			app.ExitScope();
+			if (fingerprintFile)
+				fingerprint.Save(args::get(fingerprintFile));
+
+			if (diffWith) {
+				if (oldFingerprintResult.get() != 0) {
+					std::cerr << "Failed to fingerprint " << args::get(diffWith) << "\n";
+					return 1;
+				}
+				std::cout << "Generating diff report\n";
+				stats.Begin("Diff", outDir / "diff.txt");
+				AppFingerprint oldFingerprint{ oldFingerprintPath };
+				AppFingerprint::DiffSummary summary;
+				{
+					std::ofstream of{ outDir / "diff.txt" };
+					summary = AppFingerprint::Diff(oldFingerprint, fingerprint, of);
+				}
+				stats.End();
+				std::filesystem::remove(oldFingerprintPath);
+				std::cout << std::format("classes: {} added, {} removed, {} changed\n", summary.addedClasses, summary.removedClasses,
+					summary.changedClasses);
+				std::cout << std::format("functions: {} added, {} removed, {} changed, {} renamed\n", summary.addedFunctions,
+					summary.removedFunctions, summary.changedFunctions, summary.renamedFunctions);
+			}
+
+			if (statsFile)
+				stats.WriteJson(args::get(statsFile));
+			return 0;
+		}
 
-		std::cout << "Generating Frida script\n";
-		FridaWriter fwriter{ app };
-		fwriter.Create((outDir / "blutter_frida.js").string().c_str());
+		dumpApp(app, outDir, dumpOpts, stats);
 
-		app.ExitScope();
+		if (statsFile)
+			stats.WriteJson(args::get(statsFile));
 	}
 	catch (args::Help&) {
 		std::cout << parser;